@@ -6,3 +6,31 @@ lcd.c
 
 main.c
 
+scheduler.c
+
+hcsr04.c
+
+adc.c
+
+fancurve.c
+
+pid.c
+
+fanband.c
+
+fan.c
+
+buttons.c
+
+fmt.c
+
+glyph.c
+
+stack.c
+
+uart.c
+
+telemetry.c
+
+command.c
+
@@ -0,0 +1,55 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "adc.h"
+
+static uint16_t accumulator = 0;           // sum of raw conversions
+static uint8_t conversions = 0;            // conversions in the accumulator
+static uint16_t ring[ADC_RING_SIZE];       // decimated samples
+static uint8_t ringHead = 0;
+static uint16_t ringSum = 0;               // sum over ring[]
+static volatile uint16_t filtered = 0;     // ringSum / ADC_RING_SIZE
+static volatile uint8_t filled = 0;
+
+
+ISR(ADC_vect) {
+	accumulator += ADC;
+	if (++conversions < ADC_OVERSAMPLE) {
+		return;
+	}
+
+	// Decimate: 4^n samples summed, shifted by n, gives n extra bits
+	uint16_t sample = accumulator >> ADC_OVERSAMPLE_BITS;
+	accumulator = 0;
+	conversions = 0;
+
+	ringSum += sample - ring[ringHead];
+	ring[ringHead] = sample;
+	ringHead = (ringHead + 1) & (ADC_RING_SIZE - 1);
+	if (ringHead == 0) {
+		filled = 1;
+	}
+
+	filtered = filled ? ringSum / ADC_RING_SIZE : sample;
+}
+
+void adc_init(void) {
+	ADMUX = (1 << REFS0) | (ADC_CHANNEL & 0x07); // AVcc reference, right-justified result
+	// ADC enable, free-running, interrupt on completion, CLOCK_ADC_PRESCALE
+	ADCSRA = (1 << ADEN) | (1 << ADFR) | (1 << ADIE) | CLOCK_ADC_ADPS;
+	ADCSRA |= (1 << ADSC); // First conversion starts the free-running sequence
+}
+
+uint16_t adc_value(void) {
+	uint16_t value;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		value = filtered;
+	}
+	return value;
+}
+
+uint8_t adc_ready(void) {
+	return filled;
+}
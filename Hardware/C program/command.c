@@ -0,0 +1,80 @@
+#include "command.h"
+
+enum {
+	STATE_START,     // before the command letter, blank lines are skipped
+	STATE_ARGS,      // between arguments
+	STATE_NUMBER,    // inside an argument
+	STATE_SKIP       // error, waiting for the end of the line
+};
+
+static uint8_t state = STATE_START;
+static uint8_t negative = 0;
+static uint8_t digits = 0;
+static uint16_t value = 0;          // magnitude of the argument so far
+
+
+static uint8_t end_of_line(uint8_t c) {
+	return c == '\r' || c == '\n';
+}
+
+uint8_t command_feed(uint8_t c, command_t *cmd) {
+	switch (state) {
+	case STATE_START:
+		if (end_of_line(c) || c == ' ') {
+			return COMMAND_NONE;
+		}
+		c |= 0x20; // Lower case, leaves digits and most punctuation alone
+		if (c < 'a' || c > 'z') {
+			state = STATE_SKIP;
+			return COMMAND_NONE;
+		}
+		cmd->name = c;
+		cmd->argc = 0;
+		state = STATE_ARGS;
+		return COMMAND_NONE;
+
+	case STATE_NUMBER:
+		if (c >= '0' && c <= '9') {
+			// value <= 3276 keeps the next step inside 16 bits
+			if (value > 3276 || value * 10 + (c - '0') > INT16_MAX) {
+				state = STATE_SKIP;
+			} else {
+				value = value * 10 + (c - '0');
+				digits = 1;
+			}
+			return COMMAND_NONE;
+		}
+		if (!digits) {
+			state = STATE_SKIP; // a '-' on its own
+		} else {
+			cmd->argv[cmd->argc++] = negative ? -(int16_t)value : (int16_t)value;
+			state = STATE_ARGS;
+		}
+		return command_feed(c, cmd); // The byte after a number is a separator or the end
+
+	case STATE_ARGS:
+		if (end_of_line(c)) {
+			state = STATE_START;
+			return COMMAND_READY;
+		}
+		if (c == ' ' || c == ',') {
+			return COMMAND_NONE;
+		}
+		if (cmd->argc < COMMAND_MAX_ARGS && ((c >= '0' && c <= '9') || c == '-')) {
+			negative = (c == '-');
+			digits = !negative;
+			value = negative ? 0 : c - '0';
+			state = STATE_NUMBER;
+		} else {
+			state = STATE_SKIP;
+		}
+		return COMMAND_NONE;
+
+	default:
+		if (end_of_line(c)) {
+			state = STATE_START;
+			return COMMAND_ERROR;
+		}
+		return COMMAND_NONE;
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+/*
+ * Parser for text commands arriving one byte at a time.
+ *
+ * A command is a letter followed by up to COMMAND_MAX_ARGS decimal
+ * integers, separated by spaces or commas and ended by CR or LF:
+ *
+ *   o 120
+ *   c 2,350,180
+ *
+ * command_feed() takes each byte as it is received and builds the command
+ * straight into the caller's command_t, there is no line buffer to copy
+ * out of and no byte costs more than a few instructions, so a line of any
+ * length never holds up a task. Anything that does not fit the grammar
+ * (a number out of int16_t range, too many arguments, a stray character)
+ * throws the rest of the line away and is reported at its end.
+ */
+
+#include <inttypes.h>
+
+#define COMMAND_MAX_ARGS  4
+
+// command_feed() results
+#define COMMAND_NONE      0    // line not complete yet
+#define COMMAND_READY     1    // a command is in *cmd
+#define COMMAND_ERROR     2    // malformed line, discarded
+
+typedef struct {
+	char name;                       // lower case letter
+	uint8_t argc;
+	int16_t argv[COMMAND_MAX_ARGS];
+} command_t;
+
+// Feed one received byte. *cmd is only meaningful once COMMAND_READY has
+// been returned, and must be left alone while a line is being parsed.
+extern uint8_t command_feed(uint8_t byte, command_t *cmd);
+
+#endif // COMMAND_H
@@ -0,0 +1,38 @@
+#ifndef FAN_H
+#define FAN_H
+/*
+ * PWM drive of the two fans through the L293D enable inputs, OC0 (PB4)
+ * and OC2 (PB7).
+ *
+ * Callers only set a target duty. The Timer0 overflow interrupt slews
+ * OCR0 and OCR2 towards it at FAN_RAMP_DUTY_PER_MS, so the motors never
+ * jump from stop to full duty and draw a current spike. The interrupt is
+ * only enabled while a ramp is in progress.
+ */
+
+#include <inttypes.h>
+
+#include "clock.h"
+
+#define FAN_RAMP_DUTY_PER_MS  1   // 0 to 255 in about a quarter of a second
+
+// Ramp step per Timer0 overflow (every 256 timer counts), Q8 duty
+#define FAN_RAMP_STEP_Q8  ((FAN_RAMP_DUTY_PER_MS * 65536000UL * CLOCK_PWM_PRESCALE) / F_CPU)
+
+#if FAN_RAMP_STEP_Q8 < 1 || FAN_RAMP_STEP_Q8 > 0xFFFF
+#error "FAN_RAMP_DUTY_PER_MS out of range for this F_CPU"
+#endif
+
+// Start Timer0 and Timer2 in fast PWM mode with both fans stopped
+extern void fan_init(void);
+
+// Set the duty to ramp to and return at once
+extern void fan_set_target(uint8_t duty);
+
+// Duty the ramp is heading for
+extern uint8_t fan_target(void);
+
+// Duty currently on the PWM outputs
+extern uint8_t fan_duty(void);
+
+#endif // FAN_H
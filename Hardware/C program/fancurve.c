@@ -0,0 +1,123 @@
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+
+#include "fancurve.h"
+
+static fan_point_t points[FAN_CURVE_MAX_POINTS];
+static int16_t slopes[FAN_CURVE_MAX_POINTS];   // duty per tenth of a degree, Q8, segment i .. i+1
+static uint8_t pointCount = 0;
+
+// Curve programmed through the .eep file, empty by default
+fan_curve_eeprom_t EEMEM fanCurveEeprom;
+
+
+static uint8_t checksum(const uint8_t *p, uint8_t len) {
+	uint8_t sum = 0;
+
+	while (len--) {
+		sum += *p++;
+	}
+	return sum;
+}
+
+static uint8_t curve_valid(const fan_point_t *p, uint8_t count) {
+	if (count < 2 || count > FAN_CURVE_MAX_POINTS) {
+		return 0;
+	}
+	for (uint8_t i = 1; i < count; i++) {
+		if (p[i].temp <= p[i - 1].temp) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// Precompute the slope of every segment so a lookup needs no division
+static void compute_slopes(void) {
+	for (uint8_t i = 0; i + 1 < pointCount; i++) {
+		int32_t slope = ((int32_t)(points[i + 1].duty - points[i].duty) << 8) / (points[i + 1].temp - points[i].temp);
+
+		if (slope > INT16_MAX) {
+			slope = INT16_MAX;
+		} else if (slope < INT16_MIN) {
+			slope = INT16_MIN;
+		}
+		slopes[i] = slope;
+	}
+}
+
+uint8_t fan_curve_init(const fan_point_t *defaults, uint8_t count) {
+	fan_curve_eeprom_t stored;
+	uint8_t fromEeprom = 0;
+
+	eeprom_read_block(&stored, &fanCurveEeprom, sizeof(stored));
+
+	if (stored.magic == FAN_CURVE_MAGIC
+	 && stored.checksum == checksum((const uint8_t *)&stored, sizeof(stored) - 1)
+	 && curve_valid(stored.points, stored.count)) {
+		pointCount = stored.count;
+		for (uint8_t i = 0; i < pointCount; i++) {
+			points[i] = stored.points[i];
+		}
+		fromEeprom = 1;
+	} else {
+		if (count > FAN_CURVE_MAX_POINTS) {
+			count = FAN_CURVE_MAX_POINTS;
+		}
+		memcpy_P(points, defaults, count * sizeof(fan_point_t));
+		pointCount = count;
+	}
+
+	compute_slopes();
+	return fromEeprom;
+}
+
+uint8_t fan_curve_set(uint8_t index, int16_t temp, uint8_t duty) {
+	if (index > pointCount || index >= FAN_CURVE_MAX_POINTS
+	 || (index > 0 && temp <= points[index - 1].temp)
+	 || (index + 1 < pointCount && temp >= points[index + 1].temp)) {
+		return 0;
+	}
+
+	points[index].temp = temp;
+	points[index].duty = duty;
+	if (index == pointCount) {
+		pointCount++;
+	}
+	compute_slopes();
+	return 1;
+}
+
+uint8_t fan_curve_lookup(int16_t temp, uint8_t *duty) {
+	if (temp > points[pointCount - 1].temp) {
+		*duty = 0;
+		return 0;
+	}
+	if (temp <= points[0].temp) {
+		*duty = points[0].duty;
+		return 1;
+	}
+
+	// Binary search for the segment with points[lo].temp < temp <= points[hi].temp
+	uint8_t lo = 0;
+	uint8_t hi = pointCount - 1;
+	while (hi - lo > 1) {
+		uint8_t mid = (lo + hi) >> 1;
+		if (points[mid].temp < temp) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	int16_t value = points[lo].duty + (int16_t)(((int32_t)(temp - points[lo].temp) * slopes[lo] + 128) >> 8);
+
+	if (value < 0) {
+		value = 0;
+	} else if (value > 255) {
+		value = 255;
+	}
+	*duty = value;
+	return 1;
+}
@@ -0,0 +1,44 @@
+#ifndef FANCURVE_H
+#define FANCURVE_H
+/*
+ * Fan curve: a short table of (temperature, duty) breakpoints with linear
+ * interpolation in between.
+ *
+ * The default curve is compiled into flash by the caller. fan_curve_init()
+ * replaces it with the curve stored in EEPROM when that one is valid, so
+ * a board can be retuned by programming the .eep file only.
+ */
+
+#include <inttypes.h>
+
+#define FAN_CURVE_MAX_POINTS  8
+#define FAN_CURVE_MAGIC       0xFC
+
+typedef struct {
+	int16_t temp;    // tenths of a degree C, strictly increasing along the curve
+	uint8_t duty;    // OCR0/OCR2 value at that temperature
+} fan_point_t;
+
+// Layout of the curve in EEPROM
+typedef struct {
+	uint8_t magic;                               // FAN_CURVE_MAGIC
+	uint8_t count;                               // used entries in points[]
+	fan_point_t points[FAN_CURVE_MAX_POINTS];
+	uint8_t checksum;                            // sum of all bytes before it
+} fan_curve_eeprom_t;
+
+// Load the curve from EEPROM, or from the flash table 'defaults' if the
+// EEPROM copy is missing or corrupt. Returns 1 if the EEPROM curve was used.
+extern uint8_t fan_curve_init(const fan_point_t *defaults, uint8_t count);
+
+// Interpolate the duty for a temperature in tenths of a degree C. Below the
+// first point the first duty is used. Returns 0 when the temperature is
+// above the last point, which means the reading is not plausible.
+extern uint8_t fan_curve_lookup(int16_t temp, uint8_t *duty);
+
+// Move breakpoint 'index' of the curve in use, or add one right after the
+// last. Returns 0, changing nothing, when temperatures would no longer be
+// strictly increasing. The EEPROM copy is left as it is.
+extern uint8_t fan_curve_set(uint8_t index, int16_t temp, uint8_t duty);
+
+#endif // FANCURVE_H
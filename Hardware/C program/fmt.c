@@ -0,0 +1,85 @@
+#include <avr/pgmspace.h>
+
+#include "fmt.h"
+
+#define FMT_MAX_DIGITS  5   // 65535
+
+static const uint16_t powers[FMT_MAX_DIGITS - 1] PROGMEM = { 10000, 1000, 100, 10 };
+
+
+// Digits of 'value', most significant first, returns how many
+static uint8_t digits(char *out, uint16_t value) {
+	uint8_t n = 0;
+
+	for (uint8_t i = 0; i < FMT_MAX_DIGITS - 1; i++) {
+		const uint16_t power = pgm_read_word(&powers[i]);
+		char d = '0';
+		while (value >= power) {
+			value -= power;
+			d++;
+		}
+		if (n || d != '0') {
+			out[n++] = d;
+		}
+	}
+	out[n++] = '0' + value;
+	return n;
+}
+
+// Right-align 'len' characters of 'src' in a field of 'width'
+static char *place(char *dst, uint8_t width, const char *src, uint8_t len) {
+	uint8_t i = 0;
+
+	if (len > width) {
+		while (i < width) {
+			dst[i++] = '*';
+		}
+		return dst + width;
+	}
+	while (i < width - len) {
+		dst[i++] = ' ';
+	}
+	while (i < width) {
+		dst[i++] = *src++;
+	}
+	return dst + width;
+}
+
+char *fmt_int(char *dst, uint8_t width, int16_t value) {
+	char text[FMT_MAX_DIGITS + 1];
+	uint8_t n = 0;
+
+	if (value < 0) {
+		text[n++] = '-';
+	}
+	n += digits(text + n, value < 0 ? 0u - (uint16_t)value : (uint16_t)value);
+	return place(dst, width, text, n);
+}
+
+char *fmt_fixed1(char *dst, uint8_t width, int16_t tenths) {
+	char num[FMT_MAX_DIGITS];
+	char text[FMT_MAX_DIGITS + 3];   // sign, leading zero and point
+	uint8_t n = 0;
+
+	if (tenths < 0) {
+		text[n++] = '-';
+	}
+	uint8_t count = digits(num, tenths < 0 ? 0u - (uint16_t)tenths : (uint16_t)tenths);
+	if (count == 1) {
+		text[n++] = '0';           // 0.x
+	}
+	for (uint8_t i = 0; i < count - 1; i++) {
+		text[n++] = num[i];
+	}
+	text[n++] = '.';
+	text[n++] = num[count - 1];
+	return place(dst, width, text, n);
+}
+
+char *fmt_percent(char *dst, uint8_t width, uint8_t percent) {
+	char text[FMT_MAX_DIGITS + 1];
+	uint8_t n = digits(text, percent);
+
+	text[n++] = '%';
+	return place(dst, width, text, n);
+}
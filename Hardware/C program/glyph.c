@@ -0,0 +1,88 @@
+#include <avr/pgmspace.h>
+
+#include "lcd.h"
+#include "glyph.h"
+
+#define FULL_BLOCK  ((char)0xFF)   // solid cell in the A00 character ROM
+
+// One to four columns lit from the left, the fifth is FULL_BLOCK
+static const uint8_t barGlyphs[GLYPH_BAR_STEPS - 1][GLYPH_ROWS] PROGMEM = {
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },
+	{ 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18 },
+	{ 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C },
+	{ 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E }
+};
+
+static const uint8_t *loaded[GLYPH_SLOTS];   // flash bitmap in each slot, 0 if unknown
+static uint16_t uploads = 0;
+
+
+void glyph_init(void) {
+	for (uint8_t i = 0; i < GLYPH_SLOTS; i++) {
+		loaded[i] = 0;
+	}
+	uploads = 0;
+}
+
+uint8_t glyph_load(uint8_t slot, const uint8_t *bitmap) {
+	if (slot >= GLYPH_SLOTS) {
+		return 0;
+	}
+	if (loaded[slot] == bitmap) {
+		return 1;
+	}
+
+#if LCD_ASYNC && LCD_FRAMEBUFFER
+	if (lcd_async_free() < GLYPH_ROWS + 1) {
+		return 0;
+	}
+	lcd_command_async((1 << LCD_CGRAM) | (slot << 3));
+	for (uint8_t row = 0; row < GLYPH_ROWS; row++) {
+		lcd_data_async(pgm_read_byte(&bitmap[row]));
+	}
+#else
+	lcd_command((1 << LCD_CGRAM) | (slot << 3));
+	for (uint8_t row = 0; row < GLYPH_ROWS; row++) {
+		lcd_data(pgm_read_byte(&bitmap[row]));
+	}
+#if !LCD_FRAMEBUFFER
+	lcd_home(); // back to DDRAM, lcd_fb_flush() would do this itself
+#endif
+#endif
+	loaded[slot] = bitmap;
+	uploads++;
+	return 1;
+}
+
+void glyph_bar(uint8_t x, uint8_t y, uint8_t cells, uint16_t value, uint16_t full) {
+	uint16_t columns = (uint16_t)cells * GLYPH_BAR_STEPS;
+
+	// Partial cells fall back to blanks until their glyphs are in
+	uint8_t ready = 1;
+	for (uint8_t i = 0; i < GLYPH_BAR_STEPS - 1; i++) {
+		ready &= glyph_load(GLYPH_BAR_SLOT + i, barGlyphs[i]);
+	}
+
+	if (value >= full) {
+		value = full;
+	}
+	uint16_t lit = full ? (uint16_t)(((uint32_t)value * columns + full / 2) / full) : 0;
+
+	lcd_fb_gotoxy(x, y);
+	for (uint8_t i = 0; i < cells; i++) {
+		if (lit >= GLYPH_BAR_STEPS) {
+			lcd_fb_putc(FULL_BLOCK);
+			lit -= GLYPH_BAR_STEPS;
+		} else if (lit && ready) {
+			lcd_fb_putc(GLYPH_CHAR(GLYPH_BAR_SLOT + lit - 1));
+			lit = 0;
+		} else {
+			lcd_fb_putc(' ');
+			lit = 0;
+		}
+	}
+}
+
+uint16_t glyph_uploads(void) {
+	return uploads;
+}
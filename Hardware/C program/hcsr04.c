@@ -0,0 +1,118 @@
+#include "clock.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/delay.h>
+
+#include "hcsr04.h"
+
+// Ranging state machine, advanced by the INT6 and Timer3 compare ISRs
+enum {
+	ULTRASONIC_IDLE,       // no ping in flight
+	ULTRASONIC_TRIGGERED,  // trigger sent, waiting for ECHO to rise
+	ULTRASONIC_ECHO_HIGH,  // ECHO is high, waiting for it to fall
+	ULTRASONIC_DONE,       // echoWidth holds a fresh measurement
+	ULTRASONIC_TIMEOUT     // the time slot ran out
+};
+
+static volatile uint8_t state = ULTRASONIC_IDLE;
+static volatile uint16_t echoStart;
+static volatile uint16_t echoWidth;
+static volatile uint8_t echoSeen;        // rising edge arrived before the timeout
+
+
+ISR(INT6_vect) {
+	uint16_t now = TCNT3;
+
+	if (ECHO_PINS & (1 << ECHO_PIN)) {
+		// Rising edge, the burst has been sent
+		if (state == ULTRASONIC_TRIGGERED) {
+			echoStart = now;
+			echoSeen = 1;
+			state = ULTRASONIC_ECHO_HIGH;
+		}
+	} else if (state == ULTRASONIC_ECHO_HIGH) {
+		// Falling edge, the echo came back
+		echoWidth = now - echoStart;
+		ETIMSK &= ~(1 << OCIE3A);
+		state = ULTRASONIC_DONE;
+	}
+}
+
+ISR(TIMER3_COMPA_vect) {
+	// The ping ran out of its time slot
+	ETIMSK &= ~(1 << OCIE3A);
+	if (state == ULTRASONIC_TRIGGERED || state == ULTRASONIC_ECHO_HIGH) {
+		state = ULTRASONIC_TIMEOUT;
+	}
+}
+
+void ultrasonic_init(void) {
+	// Set trigger pin as output
+	TRIGGER_DDR |= (1 << TRIGGER_PIN);
+	TRIGGER_PORT &= ~(1 << TRIGGER_PIN);
+	// Set echo pin as input without pull-up
+	ECHO_DDR &= ~(1 << ECHO_PIN);
+	ECHO_PORT &= ~(1 << ECHO_PIN);
+
+	// Timer3 free-running in normal mode, used as timestamp for the echo
+	// edges; compare match A closes the time slot of a ping
+	TCCR3A = 0x00;
+#if HCSR04_PRESCALE == 1
+	TCCR3B = (1 << CS30);
+#else
+	TCCR3B = (1 << CS31);
+#endif
+
+	// INT6 on any logical change
+	EICRB = (EICRB & ~((1 << ISC61) | (1 << ISC60))) | (1 << ISC60);
+	EIFR = (1 << INTF6);
+	EIMSK |= (1 << INT6);
+}
+
+uint8_t ultrasonic_start(void) {
+	if (state == ULTRASONIC_TRIGGERED || state == ULTRASONIC_ECHO_HIGH) {
+		return 0;
+	}
+
+	echoSeen = 0;
+
+	// Arm the timeout before the trigger so a dead sensor can't stall us.
+	// TCNT3 and OCR3A go through Timer3's TEMP register, which the INT6
+	// handler also uses when it reads TCNT3 on an echo edge.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		OCR3A = TCNT3 + HCSR04_TIMEOUT_COUNTS;
+	}
+	ETIFR = (1 << OCF3A);
+	state = ULTRASONIC_TRIGGERED;
+	ETIMSK |= (1 << OCIE3A);
+
+	// Trigger ultrasonic sensor
+	TRIGGER_PORT |= (1 << TRIGGER_PIN);
+	_delay_us(10);
+	TRIGGER_PORT &= ~(1 << TRIGGER_PIN);
+
+	return 1;
+}
+
+uint8_t ultrasonic_poll(uint16_t *distance_cm) {
+	switch (state) {
+	case ULTRASONIC_TRIGGERED:
+	case ULTRASONIC_ECHO_HIGH:
+		return ULTRASONIC_BUSY;
+
+	case ULTRASONIC_DONE:
+		// echoWidth is not written again before the next ultrasonic_start()
+		*distance_cm = echoWidth / HCSR04_COUNTS_PER_CM;
+		state = ULTRASONIC_IDLE;
+		return ULTRASONIC_OK;
+
+	case ULTRASONIC_TIMEOUT:
+		state = ULTRASONIC_IDLE;
+		return echoSeen ? ULTRASONIC_OUT_OF_RANGE : ULTRASONIC_NO_ECHO;
+
+	default:
+		return ULTRASONIC_NOT_STARTED;
+	}
+}
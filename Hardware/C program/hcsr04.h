@@ -0,0 +1,64 @@
+#ifndef HCSR04_H
+#define HCSR04_H
+/*
+ * Interrupt-driven driver for the HC-SR04 ultrasonic ranging module.
+ *
+ * TRIG is a plain output on PA6. ECHO is wired to PE6/INT6, which fires
+ * on both edges; the ISR timestamps each edge with the free-running
+ * Timer3 so the echo width is measured in hardware while the CPU keeps
+ * running the other tasks.
+ *
+ * Every ping owns a bounded time slot. Timer3 compare match A ends the
+ * slot, so a missing or stuck echo is reported as an error instead of
+ * stalling the firmware.
+ */
+
+#include <inttypes.h>
+
+#include "clock.h"
+
+// Ultrasonic sensor pins
+#define TRIGGER_PORT  PORTA
+#define TRIGGER_DDR   DDRA
+#define TRIGGER_PIN   PA6
+#define ECHO_PORT     PORTE
+#define ECHO_DDR      DDRE
+#define ECHO_PINS     PINE
+#define ECHO_PIN      PE6   // INT6
+
+// Timer3 runs at 1 or 2 counts per microsecond
+#define HCSR04_PRESCALE       CLOCK_TIMESTAMP_PRESCALE
+#define HCSR04_COUNTS_PER_US  CLOCK_TIMESTAMP_PER_US
+
+// Round trip time of sound for one centimeter is 58 us
+#define HCSR04_COUNTS_PER_CM  (58 * HCSR04_COUNTS_PER_US)
+
+// Time slot of a ping, from trigger to falling edge of ECHO. The sensor
+// holds ECHO high for about 38 ms when nothing is in range.
+#define HCSR04_TIMEOUT_MS      30
+#define HCSR04_TIMEOUT_COUNTS  (HCSR04_TIMEOUT_MS * 1000UL * HCSR04_COUNTS_PER_US)
+
+#if HCSR04_TIMEOUT_COUNTS > 0xFFFF
+#error "HC-SR04 timeout does not fit in Timer3"
+#endif
+
+// Results of ultrasonic_poll()
+enum {
+	ULTRASONIC_BUSY,          // ping still in flight
+	ULTRASONIC_OK,            // distance_cm holds a new measurement
+	ULTRASONIC_OUT_OF_RANGE,  // echo started but did not end within the slot
+	ULTRASONIC_NO_ECHO,       // ECHO never rose, sensor missing or broken
+	ULTRASONIC_NOT_STARTED    // no ping was started since the last result
+};
+
+// Configure the pins, Timer3 and INT6. Call before sei().
+extern void ultrasonic_init(void);
+
+// Fire a 10 us trigger pulse. Returns 0 if the previous ping is still running.
+extern uint8_t ultrasonic_start(void);
+
+// Never blocks. Returns ULTRASONIC_OK and stores the distance once the
+// echo of the last ping was measured, otherwise one of the codes above.
+extern uint8_t ultrasonic_poll(uint16_t *distance_cm);
+
+#endif // HCSR04_H
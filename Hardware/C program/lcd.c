@@ -13,7 +13,7 @@
        added 4-bit I/O mode, improved and optimized code.
 
        Library can be operated in memory mapped mode (LCD_IO_MODE=0) or in 
-       4-bit IO port mode (LCD_IO_MODE=1). 8-bit IO port mode not supported.
+       IO port mode (LCD_IO_MODE=1) with a 4-bit or an 8-bit data bus.
        
        Memory mapped mode compatible with Kanda STK200, but supports also
        generation of R/W signal through A8 address line.
@@ -25,7 +25,9 @@
 #include <inttypes.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <string.h>
 #include "lcd.h"
+#include "hal.h"
 
 
 
@@ -42,7 +44,16 @@
 
 
 #if LCD_IO_MODE
-#define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1:" );   //#define lcd_e_delay() __asm__ __volatile__( "rjmp 1f\n 1: rjmp 2f\n 2:" );
+/* enable pulse of at least 450ns */
+#if !defined(__AVR__)
+#define lcd_e_delay()   hal_strobe();    /* host build, the simulated LCD latches the bus */
+#elif F_CPU <= 4000000UL
+#define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1:" );
+#elif F_CPU <= 8000000UL
+#define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1: rjmp 2f\n 2:" );
+#else
+#define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1: rjmp 2f\n 2: rjmp 3f\n 3:" );
+#endif
 #define lcd_e_high()    LCD_E_PORT  |=  _BV(LCD_E_PIN);
 #define lcd_e_low()     LCD_E_PORT  &= ~_BV(LCD_E_PIN);
 #define lcd_e_toggle()  toggle_e()
@@ -52,7 +63,13 @@
 #define lcd_rs_low()    LCD_RS_PORT &= ~_BV(LCD_RS_PIN)
 #endif
 
-#if LCD_IO_MODE
+#if LCD_TIMED_MODE
+#define LCD_RW_MASK     0                   /* RW tied low, pin left alone  */
+#else
+#define LCD_RW_MASK     _BV(LCD_RW_PIN)
+#endif
+
+#if LCD_IO_MODE && !LCD_IO_8BIT
 #if LCD_LINES==1
 #define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_4BIT_1LINE 
 #else
@@ -83,6 +100,31 @@
 static void toggle_e(void);
 #endif
 
+#if LCD_TIMED_MODE
+static uint8_t lcd_line;                                /* cursor line, as the address counter cannot be read */
+#endif
+
+#if LCD_FRAMEBUFFER
+static char lcd_fb[LCD_LINES][LCD_DISP_LENGTH];        /* what should be shown     */
+static char lcd_fb_shown[LCD_LINES][LCD_DISP_LENGTH];  /* what the display shows   */
+static uint8_t lcd_fb_x, lcd_fb_y;                      /* framebuffer cursor       */
+static uint8_t lcd_fb_stale;                            /* lcd_fb_shown is unknown  */
+static uint16_t lcd_fb_total;                           /* bytes sent by all flushes */
+#endif
+
+#if LCD_ASYNC
+/* single producer (main loop) writes head, single consumer (lcd_async_tick) writes tail */
+static uint8_t lcd_q_data[LCD_ASYNC_QUEUE_SIZE];
+static uint8_t lcd_q_rs[LCD_ASYNC_QUEUE_SIZE];
+static volatile uint8_t lcd_q_head;
+static volatile uint8_t lcd_q_tail;
+static uint8_t lcd_q_wait;                              /* ticks left before the next write */
+
+/* clear display and return home take up to LCD_DELAY_CLEAR_US, everything else 37us;
+   one tick more because the write itself can come late in its tick */
+#define LCD_ASYNC_SLOW_TICKS  ((LCD_DELAY_CLEAR_US + LCD_ASYNC_TICK_US - 1) / LCD_ASYNC_TICK_US + 1)
+#endif
+
 /*
 ** local functions
 */
@@ -94,6 +136,7 @@ static void toggle_e(void);
 *************************************************************************/
 static inline void _delayFourCycles(unsigned int __count)
 {
+#ifdef __AVR__
     if ( __count == 0 )    
         __asm__ __volatile__( "rjmp 1f\n 1:" );    // 2 cycles
     else
@@ -103,6 +146,9 @@ static inline void _delayFourCycles(unsigned int __count)
     	    : "=w" (__count)
     	    : "0" (__count)
     	   );
+#else
+    hal_delay_cycles( __count ? 4UL * __count : 2 );
+#endif
 }
 
 
@@ -110,7 +156,9 @@ static inline void _delayFourCycles(unsigned int __count)
 delay for a minimum of <us> microseconds
 the number of loops is calculated at compile-time from MCU clock frequency
 *************************************************************************/
-#define delay(us)  _delayFourCycles( ( ( 1*(XTAL/4000) )*us)/1000 )
+#define delay(us)  _delayFourCycles( CLOCK_LOOPS4(us) )
+
+_Static_assert(16000 <= CLOCK_LOOPS4_MAX_US, "power-on delay does not fit the delay loop");
 
 
 #if LCD_IO_MODE
@@ -131,7 +179,27 @@ Input:    data   byte to write to LCD
                  0: write instruction
 Returns:  none
 *************************************************************************/
-#if LCD_IO_MODE
+#if LCD_IO_MODE && LCD_IO_8BIT
+static void lcd_write(uint8_t data,uint8_t rs) 
+{
+    if (rs) {   /* write data        (RS=1, RW=0) */
+       lcd_rs_high();
+    } else {    /* write instruction (RS=0, RW=0) */
+       lcd_rs_low();
+    }
+#if !LCD_TIMED_MODE
+    lcd_rw_low();
+#endif
+
+    /* whole byte in one strobe */
+    DDR(LCD_DATA_PORT) = 0xFF;
+    LCD_DATA_PORT = data;
+    lcd_e_toggle();
+
+    /* all data pins high (inactive) */
+    LCD_DATA_PORT = 0xFF;
+}
+#elif LCD_IO_MODE
 static void lcd_write(uint8_t data,uint8_t rs) 
 {
     unsigned char dataBits ;
@@ -142,7 +210,9 @@ static void lcd_write(uint8_t data,uint8_t rs)
     } else {    /* write instruction (RS=0, RW=0) */
        lcd_rs_low();
     }
+#if !LCD_TIMED_MODE
     lcd_rw_low();
+#endif
 
     if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
       && (LCD_DATA0_PIN == 0) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
@@ -212,7 +282,28 @@ Input:    rs     1: read data
                  0: read busy flag / address counter
 Returns:  byte read from LCD controller
 *************************************************************************/
-#if LCD_IO_MODE
+#if LCD_IO_MODE && LCD_IO_8BIT && !LCD_TIMED_MODE
+static uint8_t lcd_read(uint8_t rs) 
+{
+    uint8_t data;
+    
+    
+    if (rs)
+        lcd_rs_high();                       /* RS=1: read data      */
+    else
+        lcd_rs_low();                        /* RS=0: read busy flag */
+    lcd_rw_high();                           /* RW=1  read mode      */
+    
+    DDR(LCD_DATA_PORT) = 0x00;               /* configure data pins as input */
+    
+    lcd_e_high();
+    lcd_e_delay();
+    data = PIN(LCD_DATA_PORT);               /* whole byte in one strobe */
+    lcd_e_low();
+
+    return data;
+}
+#elif LCD_IO_MODE && !LCD_TIMED_MODE
 static uint8_t lcd_read(uint8_t rs) 
 {
     uint8_t data;
@@ -272,13 +363,14 @@ static uint8_t lcd_read(uint8_t rs)
     }
     return data;
 }
-#else
+#elif !LCD_IO_MODE
 #define lcd_read(rs) (rs) ? *(volatile uint8_t*)(LCD_IO_DATA+LCD_IO_READ) : *(volatile uint8_t*)(LCD_IO_FUNCTION+LCD_IO_READ)
 /* rs==0 -> read instruction from LCD_IO_FUNCTION */
 /* rs==1 -> read data from LCD_IO_DATA */
 #endif
 
 
+#if !LCD_TIMED_MODE
 /*************************************************************************
 loops while lcd is busy, returns address counter
 *************************************************************************/
@@ -297,6 +389,7 @@ static uint8_t lcd_waitbusy(void)
     return (lcd_read(0));  // return address counter
     
 }/* lcd_waitbusy */
+#endif
 
 
 /*************************************************************************
@@ -339,10 +432,41 @@ static inline void lcd_newline(uint8_t pos)
 #endif
 #endif
     lcd_command((1<<LCD_DDRAM)+addressCounter);
+#if LCD_TIMED_MODE
+    lcd_line = ( lcd_line < LCD_LINES-1 ) ? lcd_line+1 : 0;
+#endif
 
 }/* lcd_newline */
 
 
+/*************************************************************************
+Set DDRAM address command for a cursor position
+*************************************************************************/
+static inline uint8_t lcd_ddram(uint8_t x, uint8_t y)
+{
+#if LCD_LINES==1
+    return (1<<LCD_DDRAM)+LCD_START_LINE1+x;
+#endif
+#if LCD_LINES==2
+    if ( y==0 ) 
+        return (1<<LCD_DDRAM)+LCD_START_LINE1+x;
+    else
+        return (1<<LCD_DDRAM)+LCD_START_LINE2+x;
+#endif
+#if LCD_LINES==4
+    if ( y==0 )
+        return (1<<LCD_DDRAM)+LCD_START_LINE1+x;
+    else if ( y==1)
+        return (1<<LCD_DDRAM)+LCD_START_LINE2+x;
+    else if ( y==2)
+        return (1<<LCD_DDRAM)+LCD_START_LINE3+x;
+    else /* y==3 */
+        return (1<<LCD_DDRAM)+LCD_START_LINE4+x;
+#endif
+
+}/* lcd_ddram */
+
+
 /*
 ** PUBLIC FUNCTIONS 
 */
@@ -354,8 +478,17 @@ Returns: none
 *************************************************************************/
 void lcd_command(uint8_t cmd)
 {
+#if LCD_TIMED_MODE
+    lcd_write(cmd,0);
+    if ( cmd < (1<<LCD_ENTRY_MODE) ) {
+        delay(LCD_DELAY_CLEAR_US);      /* clear display, return home */
+    } else {
+        delay(LCD_DELAY_EXEC_US);
+    }
+#else
     lcd_waitbusy();
     lcd_write(cmd,0);
+#endif
 }
 
 
@@ -366,8 +499,13 @@ Returns: none
 *************************************************************************/
 void lcd_data(uint8_t data)
 {
+#if LCD_TIMED_MODE
+    lcd_write(data,1);
+    delay(LCD_DELAY_EXEC_US);
+#else
     lcd_waitbusy();
     lcd_write(data,1);
+#endif
 }
 
 
@@ -380,35 +518,22 @@ Returns:  none
 *************************************************************************/
 void lcd_gotoxy(uint8_t x, uint8_t y)
 {
-#if LCD_LINES==1
-    lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-#endif
-#if LCD_LINES==2
-    if ( y==0 ) 
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-    else
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
-#endif
-#if LCD_LINES==4
-    if ( y==0 )
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-    else if ( y==1)
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
-    else if ( y==2)
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE3+x);
-    else /* y==3 */
-        lcd_command((1<<LCD_DDRAM)+LCD_START_LINE4+x);
+    lcd_command(lcd_ddram(x, y));
+#if LCD_TIMED_MODE
+    lcd_line = y;
 #endif
 
 }/* lcd_gotoxy */
 
 
+#if !LCD_TIMED_MODE
 /*************************************************************************
 *************************************************************************/
 int lcd_getxy(void)
 {
     return lcd_waitbusy();
 }
+#endif
 
 
 /*************************************************************************
@@ -417,6 +542,9 @@ Clear display and set cursor to home position
 void lcd_clrscr(void)
 {
     lcd_command(1<<LCD_CLR);
+#if LCD_TIMED_MODE
+    lcd_line = 0;
+#endif
 }
 
 
@@ -426,6 +554,9 @@ Set cursor to home position
 void lcd_home(void)
 {
     lcd_command(1<<LCD_HOME);
+#if LCD_TIMED_MODE
+    lcd_line = 0;
+#endif
 }
 
 
@@ -436,6 +567,16 @@ Returns:  none
 *************************************************************************/
 void lcd_putc(char c)
 {
+#if LCD_TIMED_MODE
+    if (c=='\n')
+    {
+        lcd_newline(lcd_ddram(0, lcd_line) - (1<<LCD_DDRAM));
+    }
+    else
+    {
+        lcd_data(c);
+    }
+#else
     uint8_t pos;
 
 
@@ -472,6 +613,7 @@ void lcd_putc(char c)
 #endif
         lcd_write(c, 1);
     }
+#endif
 
 }/* lcd_putc */
 
@@ -510,6 +652,36 @@ void lcd_puts_p(const char *progmem_s)
 }/* lcd_puts_p */
 
 
+/*************************************************************************
+Write a whole line: one DDRAM address, then the characters back to back
+with a fixed delay each instead of a busy flag check. Short buffers are
+padded with blanks, long ones cut at the end of the line.
+Input:    row  line to overwrite (0: first line)
+          buf  characters, need not be NUL terminated
+          len  number of characters in buf
+Returns:  none
+*************************************************************************/
+void lcd_write_line(uint8_t row, const char *buf, uint8_t len)
+{
+    uint8_t x;
+
+    if ( row >= LCD_LINES ) {
+        return;
+    }
+    lcd_command(lcd_ddram(0, row));
+#if LCD_TIMED_MODE
+    lcd_line = row;
+#else
+    delay(LCD_DELAY_EXEC_US);   /* the only busy check was before the address */
+#endif
+    for (x = 0; x < LCD_DISP_LENGTH; x++) {
+        lcd_write(x < len ? buf[x] : ' ', 1);
+        delay(LCD_DELAY_EXEC_US);
+    }
+
+}/* lcd_write_line */
+
+
 /*************************************************************************
 Initialize display and select type of cursor 
 Input:    dispAttr LCD_DISP_OFF            display off
@@ -520,7 +692,24 @@ Returns:  none
 *************************************************************************/
 void lcd_init(uint8_t dispAttr)
 {
-#if LCD_IO_MODE
+#if LCD_IO_MODE && LCD_IO_8BIT
+    /*
+     *  Initialize LCD to 8 bit I/O mode
+     */
+    DDR(LCD_DATA_PORT) = 0xFF;
+    DDR(LCD_RS_PORT)   |= _BV(LCD_RS_PIN);
+    DDR(LCD_RW_PORT)   |= LCD_RW_MASK;
+    DDR(LCD_E_PORT)    |= _BV(LCD_E_PIN);
+    
+    /* reset LCD, busy flag can't be checked here */
+    delay(16000);                           /* wait 16ms after power-on     */
+    lcd_write(LCD_FUNCTION_8BIT_1LINE,0);   /* function set: 8bit interface */
+    delay(4992);                            /* wait 5ms                     */
+    lcd_write(LCD_FUNCTION_8BIT_1LINE,0);   /* function set: 8bit interface */
+    delay(64);                              /* wait 64us                    */
+    lcd_write(LCD_FUNCTION_8BIT_1LINE,0);   /* function set: 8bit interface */
+    delay(64);                              /* wait 64us                    */
+#elif LCD_IO_MODE
     /*
      *  Initialize LCD to 4 bit I/O mode
      */
@@ -531,7 +720,7 @@ void lcd_init(uint8_t dispAttr)
       && (LCD_RS_PIN == 4 ) && (LCD_RW_PIN == 5) && (LCD_E_PIN == 6 ) )
     {
         /* configure all port bits as output (all LCD lines on same port) */
-        DDR(LCD_DATA0_PORT) |= 0x7F;
+        DDR(LCD_DATA0_PORT) |= 0x5F | LCD_RW_MASK;
     }
     else if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
            && (LCD_DATA0_PIN == 0 ) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
@@ -539,14 +728,14 @@ void lcd_init(uint8_t dispAttr)
         /* configure all port bits as output (all LCD data lines on same port, but control lines on different ports) */
         DDR(LCD_DATA0_PORT) |= 0x0F;
         DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
-        DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
+        DDR(LCD_RW_PORT)    |= LCD_RW_MASK;
         DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
     }
     else
     {
         /* configure all port bits as output (LCD data and control lines on different ports */
         DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
-        DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
+        DDR(LCD_RW_PORT)    |= LCD_RW_MASK;
         DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
         DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
         DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
@@ -606,4 +795,333 @@ void lcd_init(uint8_t dispAttr)
     lcd_command(LCD_MODE_DEFAULT);          /* set entry mode               */
     lcd_command(dispAttr);                  /* display/cursor control       */
 
+#if LCD_ASYNC
+    lcd_q_head = 0;
+    lcd_q_tail = 0;
+    lcd_q_wait = 0;
+#endif
+
+#if LCD_FRAMEBUFFER
+    /* the display was just cleared, so both copies start out blank */
+    memset(lcd_fb_shown, ' ', sizeof(lcd_fb_shown));
+    lcd_fb_stale = 0;
+    lcd_fb_clear();
+#endif
+
 }/* lcd_init */
+
+
+#if LCD_FRAMEBUFFER
+/*************************************************************************
+Fill the framebuffer with blanks and move its cursor home
+*************************************************************************/
+void lcd_fb_clear(void)
+{
+    memset(lcd_fb, ' ', sizeof(lcd_fb));
+    lcd_fb_x = 0;
+    lcd_fb_y = 0;
+}
+
+
+/*************************************************************************
+Set the framebuffer cursor
+Input:    x  horizontal position  (0: left most position)
+          y  vertical position    (0: first line)
+Returns:  none
+*************************************************************************/
+void lcd_fb_gotoxy(uint8_t x, uint8_t y)
+{
+    lcd_fb_x = x;
+    lcd_fb_y = (y < LCD_LINES) ? y : LCD_LINES-1;
+}
+
+
+/*************************************************************************
+Write character into the framebuffer, no wrap at the end of a line
+Input:    character to be displayed
+Returns:  none
+*************************************************************************/
+void lcd_fb_putc(char c)
+{
+    if (c=='\n')
+    {
+        if ( lcd_fb_y < LCD_LINES-1 ) {
+            lcd_fb_y++;
+        }
+        lcd_fb_x = 0;
+    }
+    else if ( lcd_fb_x < LCD_DISP_LENGTH )
+    {
+        lcd_fb[lcd_fb_y][lcd_fb_x++] = c;
+    }
+
+}/* lcd_fb_putc */
+
+
+/*************************************************************************
+Write string into the framebuffer
+Input:    string to be displayed
+Returns:  none
+*************************************************************************/
+void lcd_fb_puts(const char *s)
+{
+    register char c;
+
+    while ( (c = *s++) ) {
+        lcd_fb_putc(c);
+    }
+
+}/* lcd_fb_puts */
+
+
+/*************************************************************************
+Write a fixed number of characters into the framebuffer
+Input:    buf  characters, need not be NUL terminated
+          len  number of characters in buf
+Returns:  none
+*************************************************************************/
+void lcd_fb_write(const char *buf, uint8_t len)
+{
+    while ( len-- ) {
+        lcd_fb_putc(*buf++);
+    }
+
+}/* lcd_fb_write */
+
+
+/*************************************************************************
+Write string from program memory into the framebuffer
+Input:    string from program memory be be displayed
+Returns:  none
+*************************************************************************/
+void lcd_fb_puts_p(const char *progmem_s)
+{
+    register char c;
+
+    while ( (c = pgm_read_byte(progmem_s++)) ) {
+        lcd_fb_putc(c);
+    }
+
+}/* lcd_fb_puts_p */
+
+
+/*************************************************************************
+Send the changed cells to the display. The address counter auto-increments,
+so a new lcd_gotoxy() is only needed where a run of changed cells starts.
+With LCD_ASYNC the bytes are queued instead, as many as fit.
+Input:    none
+Returns:  bytes sent to the controller
+*************************************************************************/
+uint8_t lcd_fb_flush(void)
+{
+    uint8_t sent = 0;
+    uint8_t x, y, cursor;
+    char c;
+
+    for (y = 0; y < LCD_LINES; y++)
+    {
+        cursor = 0xFF;      /* display cursor is not on this line */
+        for (x = 0; x < LCD_DISP_LENGTH; x++)
+        {
+            c = lcd_fb[y][x];
+            if ( !lcd_fb_stale && c == lcd_fb_shown[y][x] ) {
+                continue;
+            }
+#if LCD_ASYNC
+            /* queue full: the rest stays dirty for the next flush */
+            if ( lcd_async_free() < 2 ) {
+                lcd_fb_total += sent;
+                return sent;
+            }
+            if ( cursor != x ) {
+                lcd_command_async(lcd_ddram(x, y));
+                sent++;
+            }
+            lcd_data_async(c);
+#else
+            if ( cursor != x ) {
+                lcd_gotoxy(x, y);
+                sent++;
+            }
+            lcd_data(c);
+#endif
+            sent++;
+            lcd_fb_shown[y][x] = c;
+            cursor = x + 1;
+        }
+    }
+    lcd_fb_stale = 0;
+    lcd_fb_total += sent;
+
+    return sent;
+
+}/* lcd_fb_flush */
+
+
+/*************************************************************************
+Forget the display contents, e.g. after direct writes
+*************************************************************************/
+void lcd_fb_invalidate(void)
+{
+    lcd_fb_stale = 1;
+}
+
+
+/*************************************************************************
+Bytes sent by all flushes
+*************************************************************************/
+uint16_t lcd_fb_bytes_sent(void)
+{
+    return lcd_fb_total;
+}
+#else
+/*************************************************************************
+Write a fixed number of characters straight to the display
+Input:    buf  characters, need not be NUL terminated
+          len  number of characters in buf
+Returns:  none
+*************************************************************************/
+void lcd_fb_write(const char *buf, uint8_t len)
+{
+    while ( len-- ) {
+        lcd_putc(*buf++);
+    }
+
+}/* lcd_fb_write */
+#endif
+
+
+#if LCD_ASYNC
+/*************************************************************************
+Queue one byte, returns 0 when the queue is full
+*************************************************************************/
+static uint8_t lcd_async_put(uint8_t data, uint8_t rs)
+{
+    uint8_t head = lcd_q_head;
+    uint8_t next = (head + 1) & (LCD_ASYNC_QUEUE_SIZE - 1);
+
+    if ( next == lcd_q_tail ) {
+        return 0;
+    }
+    lcd_q_data[head] = data;
+    lcd_q_rs[head] = rs;
+    lcd_q_head = next;
+    return 1;
+
+}/* lcd_async_put */
+
+
+/*************************************************************************
+Queue instruction command
+Input:   instruction to send to LCD controller, see HD44780 data sheet
+Returns: 0 if the queue is full
+*************************************************************************/
+uint8_t lcd_command_async(uint8_t cmd)
+{
+    return lcd_async_put(cmd, 0);
+}
+
+
+/*************************************************************************
+Queue data byte
+Input:   data to send to LCD controller, see HD44780 data sheet
+Returns: 0 if the queue is full
+*************************************************************************/
+uint8_t lcd_data_async(uint8_t data)
+{
+    return lcd_async_put(data, 1);
+}
+
+
+/*************************************************************************
+Queue cursor position
+Input:    x  horizontal position  (0: left most position)
+          y  vertical position    (0: first line)
+Returns:  0 if the queue is full
+*************************************************************************/
+uint8_t lcd_gotoxy_async(uint8_t x, uint8_t y)
+{
+    return lcd_async_put(lcd_ddram(x, y), 0);
+}
+
+
+/*************************************************************************
+Queue string without auto linefeed, all of it or nothing
+Input:    string to be displayed
+Returns:  0 if the string does not fit into the queue
+*************************************************************************/
+uint8_t lcd_puts_async(const char *s)
+{
+    register char c;
+    const char *p = s;
+
+    while ( *p ) {
+        p++;
+    }
+    if ( (uint8_t)(p - s) > lcd_async_free() ) {
+        return 0;
+    }
+    while ( (c = *s++) ) {
+        lcd_async_put(c, 1);
+    }
+    return 1;
+
+}/* lcd_puts_async */
+
+
+/*************************************************************************
+Free places in the queue
+*************************************************************************/
+uint8_t lcd_async_free(void)
+{
+    return (lcd_q_tail - lcd_q_head - 1) & (LCD_ASYNC_QUEUE_SIZE - 1);
+}
+
+
+/*************************************************************************
+Nonzero once every queued byte has been written
+*************************************************************************/
+uint8_t lcd_async_idle(void)
+{
+    return lcd_q_head == lcd_q_tail && lcd_q_wait == 0;
+}
+
+
+/*************************************************************************
+Drop everything still queued, from an interrupt or with interrupts disabled
+*************************************************************************/
+void lcd_async_cancel(void)
+{
+    lcd_q_tail = lcd_q_head;
+}
+
+
+/*************************************************************************
+Write the next queued byte. Called every LCD_ASYNC_TICK_US from the timer
+interrupt; the tick period is longer than any instruction except clear and
+home, which hold off the queue for LCD_ASYNC_SLOW_TICKS instead. Both
+nibbles go out in the same call, so another interrupt can never see the
+controller halfway through a byte.
+*************************************************************************/
+void lcd_async_tick(void)
+{
+    uint8_t tail, data;
+
+    if ( lcd_q_wait ) {
+        lcd_q_wait--;
+        return;
+    }
+
+    tail = lcd_q_tail;
+    if ( tail == lcd_q_head ) {
+        return;
+    }
+    data = lcd_q_data[tail];
+    lcd_write(data, lcd_q_rs[tail]);
+    if ( !lcd_q_rs[tail] && data < (1<<LCD_ENTRY_MODE) ) {
+        lcd_q_wait = LCD_ASYNC_SLOW_TICKS - 1;
+    }
+    lcd_q_tail = (tail + 1) & (LCD_ASYNC_QUEUE_SIZE - 1);
+
+}/* lcd_async_tick */
+#endif
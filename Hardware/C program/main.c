@@ -1,72 +1,311 @@
+#include "clock.h"
 
-#define F_CPU 1000000UL
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
-#include <stdio.h>
+#include <avr/wdt.h>
+#include <avr/pgmspace.h>
 
 #include "lcd.h"
-
-// Ultrasonic sensor pins
-#define TRIGGER_PIN PA6
-#define ECHO_PIN PA7
+#include "scheduler.h"
+#include "hcsr04.h"
+#include "adc.h"
+#include "fancurve.h"
+#include "pid.h"
+#include "fanband.h"
+#include "fan.h"
+#include "buttons.h"
+#include "fmt.h"
+#include "glyph.h"
+#include "stack.h"
+#include "uart.h"
+#include "telemetry.h"
+#include "command.h"
+#include "hal.h"
+
+#if LCD_ASYNC && LCD_ASYNC_TICK_US != 1000000UL / SCHED_TICK_HZ
+#error "lcd_async_tick() runs from the scheduler tick, LCD_ASYNC_TICK_US must match SCHED_TICK_HZ"
+#endif
+
+// Occupancy threshold, someone is home when closer than this. The
+// command interface can change it up to OCCUPANCY_MAX_CM.
+#define OCCUPANCY_CM 150
+#define OCCUPANCY_MAX_CM 400
+
+// How long each screen stays on the LCD before the next one is drawn
+#define WELCOME_MS       5000
+#define DETECTION_MS     5000
+#define TEMPERATURE_MS   10000
+#define BUTTON_MS        5000
+#define NO_DETECTION_MS  10000
+#define INVALID_TEMP_MS  5000
+#define GRAPH_MS         5000
+#define REBOOT_MS        5000   // reboot message, then the watchdog resets the board
+
+// Status record on USART0 every this many ms, see telemetry.h
+#define TELEMETRY_PERIOD_MS  1000
+
+// Commands on USART0, see command.h for the syntax. Each one is answered
+// with a TELEMETRY_REPLY record, and without arguments it only reports
+// the setting.
+//   s                     send a status record now
+//   o [cm]                occupancy threshold
+//   l [mask | -1]         force PORTC to 'mask', -1 gives the LEDs back
+//   f [duty | -1]         force the fans to 'duty', -1 gives them back
+//   c i temp duty         move fan curve point i, or add it after the last
+//   b i upper hyst duty   change fan band i, FAN_CONTROL_BANDS only; in the
+//                         other modes it answers TELEMETRY_UNAVAILABLE
+#define COMMAND_BYTES_PER_RUN  16   // parsed per command_task() run, the RX ring holds 32
+#define OVERRIDE_NONE  -1
+
+// Bar graph scale, the LM35 range the firmware accepts maps onto 16 cells
+#define GRAPH_TEMP_MAX   500    // tenths of a degree C at a full bar
+
+// Default fan curve, temperature in tenths of a degree C and OCR0/OCR2 duty.
+// Readings above the last point are treated as invalid.
+static const fan_point_t fanCurve[] PROGMEM = {
+	{ 100,   0 },
+	{ 200, 100 },
+	{ 300, 155 },
+	{ 400, 200 },
+	{ 450, 255 },
+	{ 500, 255 }
+};
+
+// Fan control strategy
+#define FAN_CONTROL_CURVE  0   // open loop, duty straight from the fan curve
+#define FAN_CONTROL_PID    1   // closed loop towards PID_SETPOINT
+#define FAN_CONTROL_BANDS  2   // fixed speed steps with hysteresis
+#define FAN_CONTROL        FAN_CONTROL_CURVE
+
+// PID tuning, gains in Q8 duty per tenth of a degree for one PID_PERIOD_MS
+// step. Tune with Simulation/pid_sim.c before changing them here.
+#define PID_PERIOD_MS  1000
+#define PID_SETPOINT   260     // 26.0 C
+#define PID_KP         1280
+#define PID_KI         26
+#define PID_KD         0
+
+// Speed bands for FAN_CONTROL_BANDS: top of the band and hysteresis in
+// tenths of a degree C, duty while in the band
+#if FAN_CONTROL == FAN_CONTROL_BANDS
+#define FAN_BAND_DWELL_MS  5000
+static const fan_band_t fanBands[] PROGMEM = {
+	{ 100, 5,   0 },
+	{ 200, 5, 100 },
+	{ 300, 5, 155 },
+	{ 400, 5, 200 },
+	{   0, 0, 255 }
+};
+#endif
+
+// Every message the LCD shows, kept in flash so none of them is copied
+// into SRAM at startup. Screens refer to them by MSG_ number.
+enum {
+	MSG_NONE,
+	MSG_WELCOME,
+	MSG_MASTER,
+	MSG_DETECTED,
+	MSG_AUTO_ON,
+	MSG_NO_ONE,
+	MSG_AUTO_OFF,
+	MSG_ROOM_TEMP,
+	MSG_FAN_SPEED,
+	MSG_ERROR,
+	MSG_INVALID_TEMP,
+	MSG_REBOOT,
+	MSG_LOADING,
+	MSG_LED1,
+	MSG_LED2,
+	MSG_LED3,
+	MSG_FANS,
+	MSG_LED12,
+	MSG_LED13,
+	MSG_LED23,
+	MSG_ALL_LEDS,
+	MSG_LED1_FANS,
+	MSG_LED2_FANS,
+	MSG_LED3_FANS,
+	MSG_LED12_FANS,
+	MSG_LED13_FANS,
+	MSG_LED23_FANS,
+	MSG_SWITCHED_OFF,
+	MSG_SWITCHED_OFF_ALL,
+	MSG_FANS_AND_LEDS,
+	MSG_COUNT
+};
+
+static const char msgNone[] PROGMEM = "";
+static const char msgWelcome[] PROGMEM = "Welcome Home,";
+static const char msgMaster[] PROGMEM = "Master";
+static const char msgDetected[] PROGMEM = "Human detected.";
+static const char msgAutoOn[] PROGMEM = "Auto Switch On";
+static const char msgNoOne[] PROGMEM = "No one detected,";
+static const char msgAutoOff[] PROGMEM = "Auto Switch off";
+static const char msgRoomTemp[] PROGMEM = "Room Temp:";
+static const char msgFanSpeed[] PROGMEM = "Fan Speed:";
+static const char msgError[] PROGMEM = "Error";
+static const char msgInvalidTemp[] PROGMEM = "Invalid Temp";
+static const char msgReboot[] PROGMEM = "System Reboot";
+static const char msgLoading[] PROGMEM = "Loading...";
+static const char msgLed1[] PROGMEM = "LED1";
+static const char msgLed2[] PROGMEM = "LED2";
+static const char msgLed3[] PROGMEM = "LED3";
+static const char msgFans[] PROGMEM = "Fans";
+static const char msgLed12[] PROGMEM = "LED1, LED2";
+static const char msgLed13[] PROGMEM = "LED1, LED3";
+static const char msgLed23[] PROGMEM = "LED2, LED3";
+static const char msgAllLeds[] PROGMEM = "All LEDs";
+static const char msgLed1Fans[] PROGMEM = "LED1, Fans";
+static const char msgLed2Fans[] PROGMEM = "LED2, Fans";
+static const char msgLed3Fans[] PROGMEM = "LED3, Fans";
+static const char msgLed12Fans[] PROGMEM = "LED1, LED2, Fans";
+static const char msgLed13Fans[] PROGMEM = "LED1, LED3, Fans";
+static const char msgLed23Fans[] PROGMEM = "LED2, LED3, Fans";
+static const char msgSwitchedOff[] PROGMEM = "Switched Off";
+static const char msgSwitchedOffAll[] PROGMEM = "Switched Off all";
+static const char msgFansAndLeds[] PROGMEM = "Fans and LEDs";
+
+static const char *const messages[MSG_COUNT] PROGMEM = {
+	[MSG_NONE]             = msgNone,
+	[MSG_WELCOME]          = msgWelcome,
+	[MSG_MASTER]           = msgMaster,
+	[MSG_DETECTED]         = msgDetected,
+	[MSG_AUTO_ON]          = msgAutoOn,
+	[MSG_NO_ONE]           = msgNoOne,
+	[MSG_AUTO_OFF]         = msgAutoOff,
+	[MSG_ROOM_TEMP]        = msgRoomTemp,
+	[MSG_FAN_SPEED]        = msgFanSpeed,
+	[MSG_ERROR]            = msgError,
+	[MSG_INVALID_TEMP]     = msgInvalidTemp,
+	[MSG_REBOOT]           = msgReboot,
+	[MSG_LOADING]          = msgLoading,
+	[MSG_LED1]             = msgLed1,
+	[MSG_LED2]             = msgLed2,
+	[MSG_LED3]             = msgLed3,
+	[MSG_FANS]             = msgFans,
+	[MSG_LED12]            = msgLed12,
+	[MSG_LED13]            = msgLed13,
+	[MSG_LED23]            = msgLed23,
+	[MSG_ALL_LEDS]         = msgAllLeds,
+	[MSG_LED1_FANS]        = msgLed1Fans,
+	[MSG_LED2_FANS]        = msgLed2Fans,
+	[MSG_LED3_FANS]        = msgLed3Fans,
+	[MSG_LED12_FANS]       = msgLed12Fans,
+	[MSG_LED13_FANS]       = msgLed13Fans,
+	[MSG_LED23_FANS]       = msgLed23Fans,
+	[MSG_SWITCHED_OFF]     = msgSwitchedOff,
+	[MSG_SWITCHED_OFF_ALL] = msgSwitchedOffAll,
+	[MSG_FANS_AND_LEDS]    = msgFansAndLeds
+};
+
+// What each combination of pressed buttons does. Bit 0..2 of the index are
+// Button1..3 (LED1..3), bit 3 is Button4 (fans). MSG_NONE on the first line
+// means normal mode.
+typedef struct {
+	uint8_t leds;         // PORTC value
+	uint8_t fans;         // fans allowed to run
+	uint8_t line1;        // MSG_ number
+	uint8_t line2;        // MSG_ number
+} button_action_t;
+
+static const button_action_t buttonActions[BUTTON_MASK + 1] PROGMEM = {
+	{ 0x0F, 1, MSG_NONE,             MSG_NONE          },  // none, normal mode
+	{ 0x0E, 1, MSG_LED1,             MSG_SWITCHED_OFF  },  // Button 1
+	{ 0x0D, 1, MSG_LED2,             MSG_SWITCHED_OFF  },  // Button 2
+	{ 0x0C, 1, MSG_LED12,            MSG_SWITCHED_OFF  },  // Button 1, 2
+	{ 0x0B, 1, MSG_LED3,             MSG_SWITCHED_OFF  },  // Button 3
+	{ 0x0A, 1, MSG_LED13,            MSG_SWITCHED_OFF  },  // Button 1, 3
+	{ 0x09, 1, MSG_LED23,            MSG_SWITCHED_OFF  },  // Button 2, 3
+	{ 0x08, 1, MSG_SWITCHED_OFF,     MSG_ALL_LEDS      },  // Button 1, 2, 3
+	{ 0x0F, 0, MSG_FANS,             MSG_SWITCHED_OFF  },  // Button 4
+	{ 0x0E, 0, MSG_SWITCHED_OFF,     MSG_LED1_FANS     },  // Button 1, 4
+	{ 0x0D, 0, MSG_SWITCHED_OFF,     MSG_LED2_FANS     },  // Button 2, 4
+	{ 0x0C, 0, MSG_SWITCHED_OFF,     MSG_LED12_FANS    },  // Button 1, 2, 4
+	{ 0x0B, 0, MSG_SWITCHED_OFF,     MSG_LED3_FANS     },  // Button 3, 4
+	{ 0x0A, 0, MSG_SWITCHED_OFF,     MSG_LED13_FANS    },  // Button 1, 3, 4
+	{ 0x09, 0, MSG_SWITCHED_OFF,     MSG_LED23_FANS    },  // Button 2, 3, 4
+	{ 0x08, 0, MSG_SWITCHED_OFF_ALL, MSG_FANS_AND_LEDS }   // all buttons
+};
+
+// Screens shown by lcd_task()
+enum {
+	SCREEN_NONE,
+	SCREEN_WELCOME,
+	SCREEN_DETECTION,
+	SCREEN_TEMPERATURE,
+	SCREEN_INVALID_TEMP,
+	SCREEN_BUTTON,
+	SCREEN_NO_DETECTION,
+	SCREEN_GRAPH
+};
 
 volatile uint16_t fanSpeed = 0;
 
-void initUltrasonic() {
-	// Set trigger pin as output
-	DDRA |= (1 << TRIGGER_PIN);
-	// Set echo pin as input
-	DDRA &= ~(1 << ECHO_PIN);
-}
+// Latest sensor readings and inputs, shared between the tasks
+static int16_t temperature = 0;     // tenths of a degree C
+static uint8_t temperatureValid = 1;
+static uint16_t distance = 0;        // cm, last good HC-SR04 reading
+static int16_t occupancyCm = OCCUPANCY_CM;
+static uint8_t occupied = 0;
+static uint8_t buttons = 0;          // pressed buttons, bit n is PBn
+static uint16_t ultrasonicErrors = 0;
 
-uint16_t measureDistance() {
-	// Trigger ultrasonic sensor
-	PORTA |= (1 << TRIGGER_PIN);
-	_delay_us(10);
-	PORTA &= ~(1 << TRIGGER_PIN);
-
-	// Measure distance
-	uint16_t pulse_width = 0;
-	
-	// Wait for the rising edge
-	while (!(PINA & (1 << ECHO_PIN))) {
-		// Do nothing
-	}
-	
-	// Measure the pulse width (time taken by the sound wave to return)
-	while (PINA & (1 << ECHO_PIN)) {
-		pulse_width++;
-		_delay_us(1);
-	}
+// What the current button combination asks for
+static uint8_t ledMask = 0x0F;
+static uint8_t fansEnabled = 1;
+static uint8_t buttonLine1 = MSG_NONE;
+static uint8_t buttonLine2 = MSG_NONE;
 
-	// Calculate distance in centimeters
-	uint16_t distance_cm = (pulse_width * 10) / 58;
+// Set from the command interface, OVERRIDE_NONE when not in use
+static int16_t ledOverride = OVERRIDE_NONE;
+static int16_t fanOverride = OVERRIDE_NONE;
 
-	return distance_cm;
-}
+#if FAN_CONTROL == FAN_CONTROL_PID
+static pid_ctrl_t fanPid;
+static uint8_t pidDuty = 0;
+#endif
 
+static uint8_t screen = SCREEN_NONE;
+static uint16_t screenUntil = 0;
 
-void adc_init() {
-	ADMUX = (1 << REFS0); // Set reference voltage to AVcc and left-justify result
-	ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0); // ADC Enable and prescaler of 128
-}
+// Reboot switch (INT7). The interrupt only records the request, the time
+// is written once before the flag and never again, so it cannot tear.
+static volatile uint8_t rebootRequested = 0;
+static volatile uint16_t rebootRequestedAt = 0;
+static uint8_t rebooting = 0;       // outputs and LCD belong to reboot_task()
 
-uint16_t adc_read(uint8_t ch) {
-	ADMUX = (ADMUX & 0xF8) | (ch & 0x07); // Clear the channel selection bits and select the desired channel
-	ADCSRA |= (1 << ADSC); // Start single conversion by setting ADSC
-	while (ADCSRA & (1 << ADSC)); // Wait for conversion to complete
-	return ADC; // Read and return the ADC result
-}
 
 void pwm_init() {
-	// Initialize timer0 in PWM mode
-	TCCR0 |= (1 << WGM00) | (1 << COM01) | (1 << WGM01) | (1 << CS00);
-	TCCR2 |= (1 << WGM00) | (1 << COM01) | (1 << WGM01) | (1 << CS00);
+	// Initialize timer0 and timer2 in PWM mode, ramped by the overflow interrupt
+	fan_init();
 	// Make sure to make OC0,OC2 pin as output pin
 	DDRA = 0xFF;
 	PORTA = 0X00;
-	DDRB = 0XFF;
+	DDRB |= (1 << PB4) | (1 << PB7); // OC0 and OC2 drive the L293D enables
+}
+
+// Run the fans at 'duty', or stop them at 0
+void fanDrive(uint8_t duty) {
+	PORTA = duty ? 0x05 : 0x00;
+	fan_set_target(duty); // OCR0/OCR2 follow in the background
+	fanSpeed = ((uint16_t)duty * 100 + 127) / 255; // Fan speed in percent
+}
+
+// Select the fan speed for a temperature in tenths of a degree C. Only
+// drives the outputs, the LCD is refreshed separately by lcd_task().
+void temperatureCondition(int16_t temp)
+{
+	uint8_t duty;
+
+	// Readings above the curve turn the fan off and are reported on the LCD
+	temperatureValid = fan_curve_lookup(temp, &duty);
+#if FAN_CONTROL == FAN_CONTROL_PID
+	duty = temperatureValid ? pidDuty : 0;
+#elif FAN_CONTROL == FAN_CONTROL_BANDS
+	duty = temperatureValid ? fan_band_update(temp, scheduler_millis()) : 0;
+#endif
+
+	fanDrive(duty);
 }
 
 void led_init() {
@@ -80,351 +319,460 @@ void external_interrupt_init() {
 	EIMSK |= (1 << INT7); // Enable external interrupt INT7
 }
 
+// Flash address of a message
+const char *message(uint8_t id) {
+	return (const char *)pgm_read_ptr(&messages[id]);
+}
+
+// Draw a two-line screen from the message table
+void lcd_display_message(uint8_t line1, uint8_t line2) {
+	lcd_fb_clear();
+	lcd_fb_puts_p(message(line1));
+	lcd_fb_gotoxy(0, 1);
+	lcd_fb_puts_p(message(line2));
+}
+
 void lcd_display_welcome() {
-	lcd_clrscr();
-	lcd_gotoxy(0, 0);
-	lcd_puts("Welcome Home,");
-	lcd_gotoxy(0, 1);
-	lcd_puts("Master");
-	_delay_ms(5000);
-	lcd_clrscr();
+	lcd_display_message(MSG_WELCOME, MSG_MASTER);
 }
 
 void lcd_display_detection() {
-	lcd_gotoxy(0, 0);
-	lcd_puts("Human detected.");
-	lcd_gotoxy(0, 1);
-	lcd_puts("Auto Switch On");
-	_delay_ms(5000);
+	lcd_display_message(MSG_DETECTED, MSG_AUTO_ON);
 }
 
-void lcd_display_temperature_fan(int temp) {
-	lcd_clrscr();
-	char buffer[16]; // Create a buffer to hold the string
-	sprintf(buffer, "Room Temp: %d C", temp); // Format temperature
-	lcd_puts(buffer);
+void lcd_display_temperature_fan(int16_t temp) {
+	char field[5]; // Fixed-width fields keep every value inside its 16 columns
+
+	lcd_display_message(MSG_ROOM_TEMP, MSG_FAN_SPEED);
 
-	lcd_gotoxy(0, 1);
-	sprintf(buffer, "Fan Speed: %d%%", fanSpeed); // Format fan speed
-	lcd_puts(buffer);
+	lcd_fb_gotoxy(10, 0);
+	fmt_fixed1(field, sizeof(field), temp);
+	lcd_fb_write(field, sizeof(field));
+	lcd_fb_putc('C');
 
-	_delay_ms(5000);
+	lcd_fb_gotoxy(10, 1);
+	fmt_percent(field, sizeof(field), fanSpeed);
+	lcd_fb_write(field, sizeof(field));
+}
+
+// Temperature on the first line, actual fan duty (ramp included) on the second
+void lcd_display_graph(int16_t temp) {
+	lcd_fb_clear();
+	glyph_bar(0, 0, LCD_DISP_LENGTH, temp > 0 ? temp : 0, GRAPH_TEMP_MAX);
+	glyph_bar(0, 1, LCD_DISP_LENGTH, fan_duty(), 255);
+}
+
+void lcd_display_invalid_temperature() {
+	lcd_display_message(MSG_ERROR, MSG_INVALID_TEMP);
+}
+
+void lcd_display_button() {
+	lcd_display_message(buttonLine1, buttonLine2);
 }
 
 void lcd_display_no_detection() {
-	lcd_clrscr();
-	lcd_gotoxy(0, 0);
-	lcd_puts("No one detected,");
-	lcd_gotoxy(0, 1);
-	lcd_puts("Auto Switch off");
-	_delay_ms(5000);
+	lcd_display_message(MSG_NO_ONE, MSG_AUTO_OFF);
 }
 
 ISR(INT7_vect) {
-	// Display a message on the LCD when the interrupt is activated
-	lcd_clrscr();
-	lcd_gotoxy(0, 0);
-	lcd_puts("System Reboot");
-	lcd_gotoxy(0, 1);
-	lcd_puts("Loading...");
-	PORTC = 0x00; // Turn off all LEDs
-	PORTA = 0x00; // Turn off all fans
-	_delay_ms(5000);
+	// Keep this short, reboot_task() shows the message and resets
+	if (!rebootRequested) {
+		rebootRequestedAt = scheduler_millis();
+		rebootRequested = 1;
+	}
 }
 
-void temperatureCondition(float temp) 
-{
-	// if Button4 not pressed
-	if(PINB != 0xF7 && PINB != 0xF6 && PINB != 0xF5 && PINB != 0xF3 && PINB != 0xF4 && PINB != 0xF1 && PINB != 0xF2 && PINB != 0xF0){
-	// Control fan speed based on temperature as you did before
-		if (temp <= 10) {
-			PORTA = 0x00;
-			OCR0 = 0;
-			OCR2 = 0;
-			fanSpeed = 0; // Set fan speed to 0%
-			_delay_ms(5000);
-			lcd_display_temperature_fan((int)temp); // Display temperature on LCD
-
-		} else if ((temp >= 11) && (temp <= 20)) {
-			PORTA = 0x05;
-			OCR0 = 100;
-			OCR2 = 100;
-			fanSpeed = 25; // Set fan speed to 25%
-			_delay_ms(2000);
-			lcd_display_temperature_fan((int)temp); // Display temperature on LCD
-
-		} else if ((temp >= 21) && (temp <= 30)) {
-			PORTA = 0x05;
-			OCR0 = 155;
-			OCR2 = 155;
-			fanSpeed = 50; // Set fan speed to 50%
-			_delay_ms(5000);
-			// Display temperature on LCD
-			lcd_display_temperature_fan((int)temp);
-		} else if ((temp >= 31) && (temp <= 40)) {
-			PORTA = 0x05;
-			OCR0 = 200;
-			OCR2 = 200;
-			fanSpeed = 75; // Set fan speed to 75%
-			_delay_ms(5000);
-			lcd_display_temperature_fan((int)temp); // Display temperature on LCD
-			
-		} else if ((temp >= 41) && (temp <= 50)) {
-			PORTA = 0x05;
-			OCR0 = 255;
-			OCR2 = 255;
-			fanSpeed = 100; // Set fan speed to 100%
-			_delay_ms(5000);
-			// Display temperature on LCD
-			lcd_display_temperature_fan((int)temp);
-		} else {
-			PORTA = 0x00;
-			OCR0 = 0;
-			OCR2 = 0;
-			fanSpeed = 0; // Turn off fan
-			lcd_clrscr();
-			lcd_gotoxy(0, 0);
-			lcd_puts("Error");
-			lcd_gotoxy(0, 1);
-			lcd_puts("Invalid Temp");
-			_delay_ms(5000);
-			lcd_display_temperature_fan((int)temp); // Display temperature on LCD
 
+// Look up what the pressed buttons ask for, one table entry per combination
+void decodeButtons(uint8_t pressed) {
+	button_action_t action;
+
+	memcpy_P(&action, &buttonActions[pressed & BUTTON_MASK], sizeof(action));
+	ledMask = action.leds;
+	fansEnabled = action.fans;
+	buttonLine1 = action.line1;
+	buttonLine2 = action.line2;
+}
+
+// Drive LEDs and fans from occupancy, buttons and the last temperature,
+// unless the command interface has taken them over
+void updateOutputs() {
+	if (rebooting) {
+		return;
+	}
+
+	if (ledOverride != OVERRIDE_NONE) {
+		PORTC = ledOverride;
+	} else if (!occupied) {
+		PORTC = 0x10; // Turn off LEDs
+	} else {
+		PORTC = ledMask;
+	}
+
+	if (fanOverride != OVERRIDE_NONE) {
+		fanDrive(fanOverride);
+	} else if (occupied && fansEnabled) {
+		temperatureCondition(temperature);
+	} else {
+		fanDrive(0); // Turn off fans, the PWM ramps down with them
+	}
+}
+
+
+/*
+ * Tasks run by the scheduler
+ */
+
+void temperature_task() {
+	// Filtered LM35 reading (ADC0/PF0), kept up to date by the ADC interrupt
+	const uint16_t adcValue = adc_value();
+
+	temperature = LM35_DECI_C(adcValue);
+}
+
+void ultrasonic_task() {
+	uint16_t cm;
+	uint8_t present = occupied;
+
+	// Collect the result of the previous ping, then send the next one
+	switch (ultrasonic_poll(&cm)) {
+	case ULTRASONIC_OK:
+		distance = cm;
+		present = distance <= occupancyCm;
+		break;
+	case ULTRASONIC_OUT_OF_RANGE:
+		present = 0;
+		break;
+	case ULTRASONIC_NO_ECHO:
+		// Sensor missing, fall back to the unoccupied state so the fans stop
+		ultrasonicErrors++;
+		present = 0;
+		break;
+	}
+
+	if (present != occupied) {
+		occupied = present;
+		updateOutputs();
+	}
+	ultrasonic_start();
+}
+
+void button_task() {
+	uint8_t event;
+	uint8_t changed = 0;
+
+	// Drain the debouncer queue; the buttons act while they are held, so
+	// every press or release re-decodes the debounced combination. Long
+	// presses have no action of their own.
+	while ((event = buttons_event()) != BUTTON_NONE) {
+		if (BUTTON_EVENT_TYPE(event) != BUTTON_LONG) {
+			changed = 1;
 		}
-	
-	}else {
-		_delay_ms(200);
-		// Display temperature on LCD
-		lcd_display_temperature_fan((int)temp);
 	}
-		
+
+	if (changed) {
+		buttons = buttons_state();
+		decodeButtons(buttons);
+		updateOutputs();
+	}
 }
 
-void normalMode(){
-		
-		lcd_display_welcome();
+void fan_task() {
+#if FAN_CONTROL == FAN_CONTROL_BANDS
+	fan_band_clock(scheduler_millis()); // Readings stop while the fans are off
+#endif
+	updateOutputs();
+}
+
+#if FAN_CONTROL == FAN_CONTROL_PID
+void pid_task() {
+	if (occupied && fansEnabled) {
+		pidDuty = pid_update(&fanPid, temperature);
+	} else {
+		// Start again without stale history when the fan is enabled again
+		pid_reset(&fanPid);
+		pidDuty = 0;
+	}
+}
+#endif
+
+// Pick the screen that follows 'prev', mirroring the order of the old main loop
+uint8_t nextScreen(uint8_t prev) {
+	if (!occupied) {
+		return SCREEN_NO_DETECTION;
+	}
+	if (buttonLine1 != MSG_NONE) {
+		return (prev == SCREEN_TEMPERATURE) ? SCREEN_BUTTON : SCREEN_TEMPERATURE;
+	}
 
-		// Turn on LEDs and display a message
-		PORTC = 0x0F; // Turn on LEDs
-		
+	switch (prev) {
+	case SCREEN_WELCOME:
+		return SCREEN_DETECTION;
+	case SCREEN_DETECTION:
+	case SCREEN_INVALID_TEMP:
+		return SCREEN_TEMPERATURE;
+	case SCREEN_TEMPERATURE:
+		return SCREEN_GRAPH;
+	default:
+		return SCREEN_WELCOME;
+	}
+}
+
+void lcd_task() {
+	if (rebooting) {
+		return;
+	}
+	if (!scheduler_expired(screenUntil)) {
+#if LCD_FRAMEBUFFER
+		// Keep the readings live, only the digits that change are sent.
+		// Direct writes would redraw the whole screen every time.
+		if (screen == SCREEN_TEMPERATURE) {
+			lcd_display_temperature_fan(temperature);
+		} else if (screen == SCREEN_GRAPH) {
+			lcd_display_graph(temperature);
+		}
+		lcd_fb_flush();
+#endif
+		return;
+	}
+
+	uint8_t next = nextScreen(screen);
+	uint16_t hold;
+
+	// A bad reading is reported once before the temperature screen
+	if (next == SCREEN_TEMPERATURE && fansEnabled && !temperatureValid && screen != SCREEN_INVALID_TEMP) {
+		next = SCREEN_INVALID_TEMP;
+	}
+
+	switch (next) {
+	case SCREEN_WELCOME:
+		lcd_display_welcome();
+		hold = WELCOME_MS;
+		break;
+	case SCREEN_DETECTION:
 		lcd_display_detection();
-		
+		hold = DETECTION_MS;
+		break;
+	case SCREEN_TEMPERATURE:
+		lcd_display_temperature_fan(temperature);
+		hold = TEMPERATURE_MS;
+		break;
+	case SCREEN_GRAPH:
+		lcd_display_graph(temperature);
+		hold = GRAPH_MS;
+		break;
+	case SCREEN_INVALID_TEMP:
+		lcd_display_invalid_temperature();
+		hold = INVALID_TEMP_MS;
+		break;
+	case SCREEN_BUTTON:
+		lcd_display_button();
+		hold = BUTTON_MS;
+		break;
+	default:
+		lcd_display_no_detection();
+		hold = NO_DETECTION_MS;
+		break;
+	}
+
+	screen = next;
+	screenUntil = scheduler_millis() + hold;
+	lcd_fb_flush();
+}
+
+void reboot_task() {
+	if (!rebootRequested) {
+		return;
+	}
+
+	if (!rebooting) {
+		// Safe state first; updateOutputs() and lcd_task() stand back from now on
+		rebooting = 1;
+		PORTC = 0x00; // Turn off all LEDs
+		PORTA = 0x00; // Turn off all fans
+		fan_set_target(0);
+		lcd_display_message(MSG_REBOOT, MSG_LOADING);
+	}
+	lcd_fb_flush(); // Until the whole message has fitted into the LCD queue
+
+	if ((uint16_t)(scheduler_millis() - rebootRequestedAt) >= REBOOT_MS) {
+		wdt_enable(WDTO_15MS);
+		while (1) {
+			// Wait for the watchdog to reset the chip
+		}
+	}
+}
+
+// Diagnostics that only need a look now and then
+void diag_task() {
+	stack_update(); // Catch the deepest stack, ISRs on top of tasks included
+}
+
+// Status record for a logger on USART0. Dropped, not waited for, when the
+// line is busy; the sequence number shows the gap.
+void telemetry_task() {
+	telemetry_status_t status;
+
+	status.millis = scheduler_millis();
+	status.temperature = temperature;
+	status.distance = distance;
+	status.occupied = occupied;
+	status.buttons = buttons;
+	status.leds = PORTC;
+	status.fanTarget = fan_target();
+	status.fanDuty = fan_duty();
+	status.flags = (temperatureValid ? TELEMETRY_TEMP_VALID : 0)
+	             | (fansEnabled ? TELEMETRY_FANS_ON : 0)
+	             | (rebooting ? TELEMETRY_REBOOTING : 0);
+	status.ultrasonicErrors = ultrasonicErrors;
+	status.stackMaxUsed = stack_max_used();
+	status.stackFree = stack_unused();
+	status.drops = telemetry_drops();
+	status.rxErrors = uart_rx_errors();
+#if FAN_CONTROL == FAN_CONTROL_BANDS
+	status.bandChanges = fan_band_transitions_per_hour();
+#else
+	status.bandChanges = 0;
+#endif
+	telemetry_send(TELEMETRY_STATUS, &status, sizeof(status));
+}
+
+// Report or change a one-number setting. Returns a TELEMETRY_ result.
+uint8_t commandSetting(const command_t *cmd, int16_t *setting, int16_t min, int16_t max) {
+	if (cmd->argc > 1 || (cmd->argc == 1 && (cmd->argv[0] < min || cmd->argv[0] > max))) {
+		return TELEMETRY_BAD_ARGS;
+	}
+	if (cmd->argc == 1) {
+		*setting = cmd->argv[0];
+	}
+	return TELEMETRY_OK;
+}
+
+// Carry out one command, '*value' is what the reply reports
+uint8_t commandRun(const command_t *cmd, int16_t *value) {
+	const int16_t *arg = cmd->argv;
+	uint8_t result = TELEMETRY_BAD_ARGS;
+
+	*value = 0;
+	switch (cmd->name) {
+	case 's':
+		if (cmd->argc == 0) {
+			telemetry_task();
+			result = TELEMETRY_OK;
+		}
+		break;
+	case 'o':
+		result = commandSetting(cmd, &occupancyCm, 1, OCCUPANCY_MAX_CM);
+		*value = occupancyCm; // Applies from the next ping
+		break;
+	case 'l':
+		result = commandSetting(cmd, &ledOverride, OVERRIDE_NONE, 0x1F);
+		*value = ledOverride;
+		break;
+	case 'f':
+		result = commandSetting(cmd, &fanOverride, OVERRIDE_NONE, 255);
+		*value = fanOverride;
+		break;
+	case 'c':
+		if (cmd->argc == 3 && arg[0] >= 0 && arg[0] <= 255 && arg[2] >= 0 && arg[2] <= 255
+		 && fan_curve_set(arg[0], arg[1], arg[2])) {
+			result = TELEMETRY_OK;
+			*value = arg[0];
+		}
+		break;
+	case 'b':
+#if FAN_CONTROL == FAN_CONTROL_BANDS
+		if (cmd->argc == 4 && arg[0] >= 0 && arg[0] <= 255 && arg[2] >= 0 && arg[2] <= 255
+		 && arg[3] >= 0 && arg[3] <= 255 && fan_band_set(arg[0], arg[1], arg[2], arg[3])) {
+			result = TELEMETRY_OK;
+			*value = arg[0];
+		}
+#else
+		result = TELEMETRY_UNAVAILABLE; // No band table loaded
+#endif
+		break;
+	default:
+		result = TELEMETRY_UNKNOWN;
+		break;
+	}
+
+	updateOutputs(); // Overrides and new thresholds take effect at once
+	return result;
+}
+
+// Parse what USART0 received, a few bytes per run so a flood of input
+// cannot hold up the other tasks; the rest waits in the RX ring
+void command_task() {
+	static command_t cmd; // Built up across runs, byte by byte
+	telemetry_reply_t reply;
+	int16_t value = 0;
+	uint8_t byte;
+
+	for (uint8_t n = 0; n < COMMAND_BYTES_PER_RUN && uart_read(&byte); n++) {
+		switch (command_feed(byte, &cmd)) {
+		case COMMAND_READY:
+			reply.command = cmd.name;
+			reply.result = commandRun(&cmd, &value);
+			reply.value = value;
+			break;
+		case COMMAND_ERROR:
+			reply.command = '?';
+			reply.result = TELEMETRY_BAD_LINE;
+			reply.value = 0;
+			break;
+		default:
+			continue;
+		}
+		telemetry_send(TELEMETRY_REPLY, &reply, sizeof(reply));
+	}
 }
 
 
 int main(void) {
+	wdt_disable(); // Only reboot_task() uses the watchdog
+
 	// Initialization code for peripherals
 	adc_init();
 	pwm_init();
-	initUltrasonic(); // Initialize ultrasonic sensor
+	ultrasonic_init(); // Initialize ultrasonic sensor
 	lcd_init(LCD_DISP_ON);
+	glyph_init();
 	led_init();
 	external_interrupt_init();
-	DDRB = 0x00;
-	PORTB = 0xFF;
-	
-	
+	buttons_init();
+	uart_init();
+	fan_curve_init(fanCurve, sizeof(fanCurve) / sizeof(fanCurve[0]));
+#if FAN_CONTROL == FAN_CONTROL_PID
+	pid_init(&fanPid, PID_KP, PID_KI, PID_KD, PID_SETPOINT, 0, 255);
+#elif FAN_CONTROL == FAN_CONTROL_BANDS
+	fan_band_init(fanBands, sizeof(fanBands) / sizeof(fanBands[0]), FAN_BAND_DWELL_MS);
+#endif
+	scheduler_init();
+	scheduler_add_tick_hook(buttons_tick);
+#if LCD_ASYNC
+	scheduler_add_tick_hook(lcd_async_tick); // Drains lcd_fb_flush(), one byte per millisecond
+#endif
+
+	//             task               period  deadline (ms)
+	scheduler_add(button_task,        5,      5);
+	scheduler_add(temperature_task,   100,    50);
+	scheduler_add(ultrasonic_task,    100,    50);
+	scheduler_add(fan_task,           200,    100);
+#if FAN_CONTROL == FAN_CONTROL_PID
+	scheduler_add(pid_task,           PID_PERIOD_MS, 10);
+#endif
+	scheduler_add(lcd_task,           50,     50);
+	scheduler_add(reboot_task,        10,     10);
+	scheduler_add(diag_task,          100,    100);
+	scheduler_add(telemetry_task,     TELEMETRY_PERIOD_MS, 50);
+	scheduler_add(command_task,       10,     10);
+
 	sei(); // Enable global interrupts
 
 	while (1) {
-			// Read temperature from LM35 (ADC0/PF0)
-			const int adcValue = adc_read(0); // Read from ADC0/PF0
-
-			// Calculate temperature in degrees Celsius
-			// The LM35 has a sensitivity of 10 mV/C and a reference voltage of 5V (AVcc)
-			const float temp = (adcValue / 1024.0) * 500.0; // 500 mV/C
-
-			uint16_t distance =  measureDistance(); // Calculate distance in centimeters
-			
-				if (distance <= 150) { // less than 1.5 m
-					
-
-					if (PINB == 0xFE) { // Button 1 (PB0)
-						PORTC = 0x0E; // Turn off LED1 (PC0)
-						PORTA = 0x05;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("LED1");
-						lcd_gotoxy(0, 1);
-						lcd_puts("Switched Off");						
-						
-					}
-					else if (PINB == 0xFD) { // Button 2 (PB1)
-						PORTC = 0x0D; // Turn off LED2 (PC1)
-						PORTA = 0x05;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("LED2");
-						lcd_gotoxy(0, 1);
-						lcd_puts("Switched Off");
-
-					}
-					else if (PINB == 0xFB) { // Button 3 (PB2)
-						PORTC = 0x0B; // Turn off LED3 (PC2)
-						PORTA = 0x05;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("LED3");
-						lcd_gotoxy(0, 1);
-						lcd_puts("Switched Off");
-					}
-					else if (PINB == 0xF7) { // Button 4 (Fan Control) (PB3) 
-						PORTC = 0x0F;
-						PORTA = 0x00;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Fans");
-						lcd_gotoxy(0, 1);
-						lcd_puts("Switched Off");
-				
-
-					}
-					else if (PINB == 0xFC) { 
-						PORTC = 0x0C; // Turn off LED1 (PC0) and LED2 (PC1)
-						PORTA = 0x05;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("LED1, LED2");
-						lcd_gotoxy(0, 1);
-						lcd_puts("Switched Off");
-
-		
-					} 
-					else if (PINB == 0xFA) { 
-						PORTC = 0x0A;  // Turn off LED1 (PC0) and LED3 (PC2)
-						PORTA = 0x05;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("LED1, LED3");
-						lcd_gotoxy(0, 1);
-						lcd_puts("Switched Off");
-
-					}
-					else if (PINB == 0xF9) { 
-						PORTC = 0x09;  // Turn off LED2 and LED3 (PC2)
-						PORTA = 0x05;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("LED1, LED3");
-						lcd_gotoxy(0, 1);
-						lcd_puts("Switched Off");
-
-					}
-					else if (PINB == 0xF8) { // Turn off all LEDs
-						PORTC = 0x08; 
-						PORTA = 0x05;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Switched Off");
-						lcd_gotoxy(0, 1);
-						lcd_puts("All LEDs");
-
-					}
-					else if (PINB == 0xF6) { //  Turn off LED1 (PC0) and Button 4 (Fan Control) (PB3) 
-
-						PORTC = 0x0E;
-						PORTA = 0x00;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Switched Off");
-						lcd_gotoxy(0, 1);
-						lcd_puts("LED1, Fans");
-
-					}
-					else if (PINB == 0xF5) { //  Turn off LED2 (PC1) and Button 4 (Fan Control) (PB3)
-
-						PORTC = 0x0D;
-						PORTA = 0x00;
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Switched Off");
-						lcd_gotoxy(0, 1);
-						lcd_puts("LED2, Fans");
-						temperatureCondition(temp);
-
-					}
-					else if (PINB == 0xF3) { //  Turn off LED3 (PC2) and Button 4 (Fan Control) (PB3)
-
-						PORTC = 0x0B;
-						PORTA = 0x00;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Switched Off");
-						lcd_gotoxy(0, 1);
-						lcd_puts("LED3, Fans");
-
-					}
-					else if (PINB == 0xF4) { //  Turn off LED1, LED2 and Button 4 (Fan Control) (PB3)
-
-						PORTC = 0x0C;
-						PORTA = 0x00;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Switched Off");
-						lcd_gotoxy(0, 1);
-						lcd_puts("LED1, LED2, Fans");
-					}
-					else if (PINB == 0xF1) { //  Turn off LED2, LED3 and Button 4 (Fan Control) (PB3)
-						PORTC = 0x09;
-						PORTA = 0x00;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Switched Off");
-						lcd_gotoxy(0, 1);
-						lcd_puts("LED2, LED3, Fans");
-
-					}
-					else if (PINB == 0xF2) { //  Turn off LED1, LED3 and Button 4 (Fan Control) (PB3)
-
-						PORTC = 0x0A;
-						PORTA = 0x00;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Switched Off");
-						lcd_gotoxy(0, 1);
-						lcd_puts("LED1, LED3, Fans");
-					}
-					else if (PINB == 0xF0) { //  Turn off LED1, LED2, LED3 and Button 4 (Fan Control) (PB3)
-
-						PORTC = 0x08;
-						PORTA = 0x00;
-						temperatureCondition(temp);
-						lcd_clrscr();
-						lcd_gotoxy(0, 0);
-						lcd_puts("Switched Off all");
-						lcd_gotoxy(0, 1);
-						lcd_puts("Fans and LEDs");
-					}
-					else {
-						normalMode();
-						temperatureCondition(temp);
-					}
-					
-				} else {
-					// Turn off LEDs and display a message
-					PORTC = 0x10;
-					PORTA &= ~((1 << PA0) | (1 << PA1) | (1 << PA2) | (1 << PA3)); // Turn off fans
-					lcd_display_no_detection();
-				}
-			
-			
-	
-		_delay_ms(5000); // Delay for smoother operation
+		scheduler_run();
+		hal_idle();
 	}
-		
+
 	return 0; // Return 0 to indicate successful execution (optional)
 }
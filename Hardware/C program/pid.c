@@ -0,0 +1,58 @@
+#include "pid.h"
+
+void pid_init(pid_ctrl_t *pid, int16_t kp, int16_t ki, int16_t kd,
+              int16_t setpoint, uint8_t outMin, uint8_t outMax) {
+	pid->kp = kp;
+	pid->ki = ki;
+	pid->kd = kd;
+	pid->setpoint = setpoint;
+	pid->outMin = outMin;
+	pid->outMax = outMax;
+	pid_reset(pid);
+}
+
+void pid_reset(pid_ctrl_t *pid) {
+	pid->integral = (int32_t)pid->outMin << 8;
+	pid->lastMeasurement = 0;
+	pid->primed = 0;
+}
+
+uint8_t pid_update(pid_ctrl_t *pid, int16_t measurement) {
+	const int32_t min = (int32_t)pid->outMin << 8;
+	const int32_t max = (int32_t)pid->outMax << 8;
+
+	// Reverse acting: too warm means a positive error and more fan
+	int16_t error = measurement - pid->setpoint;
+	int16_t delta = pid->primed ? measurement - pid->lastMeasurement : 0;
+	pid->lastMeasurement = measurement;
+	pid->primed = 1;
+
+	int32_t proportional = (int32_t)pid->kp * error;
+	int32_t derivative = (int32_t)pid->kd * delta;
+
+	int32_t integral = pid->integral + (int32_t)pid->ki * error;
+	if (integral > max) {
+		integral = max;
+	} else if (integral < min) {
+		integral = min;
+	}
+
+	int32_t output = proportional + integral + derivative;
+
+	// Only let the integral move if that doesn't push a saturated output further
+	if (output > max) {
+		output = max;
+		if (integral < pid->integral) {
+			pid->integral = integral;
+		}
+	} else if (output < min) {
+		output = min;
+		if (integral > pid->integral) {
+			pid->integral = integral;
+		}
+	} else {
+		pid->integral = integral;
+	}
+
+	return (uint8_t)((output + 128) >> 8);
+}
@@ -0,0 +1,102 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "scheduler.h"
+
+typedef struct {
+	task_fn_t run;
+	uint16_t period;     // ms between releases
+	uint16_t deadline;   // ms of lateness tolerated after a release
+	uint16_t release;    // tick at which the task is next due
+	uint16_t misses;     // releases started after their deadline
+} task_t;
+
+static task_t tasks[SCHED_MAX_TASKS];
+static uint8_t taskCount = 0;
+
+static task_fn_t hooks[SCHED_MAX_HOOKS];
+static uint8_t hookCount = 0;
+
+static volatile uint16_t ticks = 0;
+
+
+ISR(TIMER1_COMPA_vect) {
+	ticks++;
+
+	for (uint8_t i = 0; i < hookCount; i++) {
+		hooks[i]();
+	}
+}
+
+void scheduler_init(void) {
+	// Timer1 in CTC mode (TOP = OCR1A), no prescaler, compare match every 1 ms
+	TCCR1A = 0x00;
+	TCCR1B = (1 << WGM12) | (1 << CS10);
+	OCR1A = (F_CPU / SCHED_TICK_HZ) - 1;
+	TCNT1 = 0;
+	TIMSK |= (1 << OCIE1A);
+}
+
+uint16_t scheduler_millis(void) {
+	uint16_t now;
+
+	// 16-bit read of a variable written by the ISR must not be torn
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		now = ticks;
+	}
+	return now;
+}
+
+uint8_t scheduler_add(task_fn_t fn, uint16_t period_ms, uint16_t deadline_ms) {
+	if (taskCount >= SCHED_MAX_TASKS) {
+		return 0xFF;
+	}
+
+	task_t *t = &tasks[taskCount];
+	t->run = fn;
+	t->period = period_ms;
+	t->deadline = deadline_ms;
+	t->release = scheduler_millis() + period_ms;
+	t->misses = 0;
+
+	return taskCount++;
+}
+
+uint8_t scheduler_add_tick_hook(task_fn_t fn) {
+	uint8_t added = 0;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (hookCount < SCHED_MAX_HOOKS) {
+			hooks[hookCount++] = fn;
+			added = 1;
+		}
+	}
+	return added;
+}
+
+void scheduler_run(void) {
+	for (uint8_t i = 0; i < taskCount; i++) {
+		task_t *t = &tasks[i];
+		uint16_t now = scheduler_millis();
+
+		if ((int16_t)(now - t->release) < 0) {
+			continue; // not due yet
+		}
+		if ((uint16_t)(now - t->release) > t->deadline) {
+			t->misses++;
+		}
+
+		// Keep the task on its original phase, unless it fell a whole period behind
+		t->release += t->period;
+		if ((int16_t)(now - t->release) >= 0) {
+			t->release = now + t->period;
+		}
+
+		t->run();
+	}
+}
+
+uint16_t scheduler_misses(uint8_t id) {
+	return (id < taskCount) ? tasks[id].misses : 0;
+}
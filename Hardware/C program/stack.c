@@ -0,0 +1,89 @@
+#include <avr/io.h>
+
+#include "stack.h"
+
+#ifdef __AVR__
+
+extern uint8_t __heap_start;    // end of .bss (and .noinit), from the linker script
+extern uint8_t __data_start;    // start of .data, the bottom of SRAM
+
+static uint8_t *edge = (uint8_t *)RAMEND + 1;   // lowest address known to be used
+static uint8_t *scan = &__heap_start;           // where the current pass goes on
+
+
+// Runs from .init3: SP is set up (.init2) but .data and .bss are not yet
+// initialised (.init4), and neither is touched as painting starts above
+// them. Plain asm so nothing depends on the stack or on r1 being zero.
+void stack_paint(void) __attribute__((naked, used, section(".init3")));
+void stack_paint(void) {
+	__asm__ __volatile__(
+		"    ldi r30, lo8(__heap_start)   \n"
+		"    ldi r31, hi8(__heap_start)   \n"
+		"    ldi r24, %0                  \n"
+		"    ldi r25, hi8(%1)             \n"
+		"    rjmp 2f                      \n"
+		"1:  st Z+, r24                   \n"
+		"2:  cpi r30, lo8(%1)             \n"
+		"    cpc r31, r25                 \n"
+		"    brlo 1b                      \n"
+		"    breq 1b                      \n"
+		:: "i" (STACK_CANARY), "i" (RAMEND)
+	);
+}
+
+void stack_update(void) {
+	uint8_t *p = scan;
+	uint8_t n = STACK_SCAN;
+
+	// Upwards from the end of .bss, so a buffer on the stack that was never
+	// filled cannot hide the frames below it
+	while (n-- && p < edge) {
+		if (*p != STACK_CANARY) {
+			edge = p;
+			break;
+		}
+		p++;
+	}
+	scan = (p < edge) ? p : &__heap_start; // Next pass from the bottom again
+}
+
+uint16_t stack_max_used(void) {
+	return (uint8_t *)RAMEND + 1 - edge;
+}
+
+uint16_t stack_unused(void) {
+	return edge - &__heap_start;
+}
+
+uint16_t stack_free(void) {
+	return (uint8_t *)SP - &__heap_start;
+}
+
+uint16_t stack_static(void) {
+	return &__heap_start - &__data_start;
+}
+
+#else
+
+// Host build: there is no AVR stack to measure, everything reads as zero
+
+void stack_update(void) {
+}
+
+uint16_t stack_max_used(void) {
+	return 0;
+}
+
+uint16_t stack_unused(void) {
+	return 0;
+}
+
+uint16_t stack_free(void) {
+	return 0;
+}
+
+uint16_t stack_static(void) {
+	return 0;
+}
+
+#endif
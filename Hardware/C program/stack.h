@@ -0,0 +1,42 @@
+#ifndef STACK_H
+#define STACK_H
+/*
+ * Stack high-water mark by painting free RAM.
+ *
+ * Before main() runs, everything between the end of .bss and RAMEND is
+ * filled with STACK_CANARY. Bytes the stack (or an interrupt nested on
+ * top of it) has ever used no longer hold the canary, so the lowest one
+ * marks the deepest the stack has been. stack_update() looks for it
+ * from the end of .bss upwards, never from the stack down, because a
+ * local buffer that was only partly written leaves canary bytes inside
+ * stack that was really used. Each call checks at most STACK_SCAN bytes
+ * and the next one carries on from there, so a pass over the free RAM
+ * is spread over many calls.
+ *
+ * The firmware does not use malloc(), the heap is empty and the gap
+ * between .bss and the stack is all free RAM.
+ */
+
+#include <inttypes.h>
+
+#define STACK_CANARY  0xC5
+#define STACK_SCAN    64      // bytes checked per stack_update() call
+
+// Move the high-water mark down to the lowest byte the stack has used.
+// Cheap, call it periodically from a task; with about 3 KB free and a
+// call every 100 ms a new mark is seen within 5 s.
+extern void stack_update(void);
+
+// Deepest stack seen by stack_update(), in bytes below RAMEND
+extern uint16_t stack_max_used(void);
+
+// Bytes between the end of .bss and the deepest stack seen, never touched
+extern uint16_t stack_unused(void);
+
+// Bytes between the end of .bss and the stack pointer right now
+extern uint16_t stack_free(void);
+
+// Bytes of SRAM taken by .data and .bss
+extern uint16_t stack_static(void);
+
+#endif // STACK_H
@@ -0,0 +1,70 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+/*
+ * Binary telemetry records on USART0.
+ *
+ * A record is a sequence number, a type and up to TELEMETRY_MAX_PAYLOAD
+ * bytes of payload, followed by a CRC-8 (polynomial 0x07, initial value 0)
+ * over all of them. The lot is COBS encoded, so it contains no zero byte,
+ * and a 0x00 ends the frame: a receiver that starts mid-stream, or loses
+ * bytes, is back in step at the next zero.
+ *
+ * The sequence number counts every record, sent or not, so gaps on the
+ * receiving side show how many were dropped because uart.c was full.
+ * Multi-byte fields are little-endian, as the AVR stores them.
+ */
+
+#include <inttypes.h>
+
+#define TELEMETRY_MAX_PAYLOAD  32
+
+// Record types
+#define TELEMETRY_STATUS  0x01    // telemetry_status_t
+#define TELEMETRY_REPLY   0x02    // telemetry_reply_t, answer to a command
+
+// Flags in telemetry_status_t
+#define TELEMETRY_TEMP_VALID  0x01
+#define TELEMETRY_FANS_ON     0x02    // fans enabled by the buttons
+#define TELEMETRY_REBOOTING   0x04
+
+// Results in telemetry_reply_t
+#define TELEMETRY_OK          0
+#define TELEMETRY_BAD_LINE    1    // not a command, see command.h
+#define TELEMETRY_UNKNOWN     2    // no such command
+#define TELEMETRY_BAD_ARGS    3    // wrong number of arguments or out of range
+#define TELEMETRY_UNAVAILABLE 4    // not available with this FAN_CONTROL
+
+typedef struct __attribute__((packed)) {
+	uint16_t millis;              // scheduler_millis() when sent
+	int16_t temperature;          // tenths of a degree C
+	uint16_t distance;            // cm, last good HC-SR04 reading
+	uint8_t occupied;
+	uint8_t buttons;              // pressed buttons, bit n is PBn
+	uint8_t leds;                 // PORTC
+	uint8_t fanTarget;            // duty asked for
+	uint8_t fanDuty;              // duty on OCR0/OCR2 now, ramp included
+	uint8_t flags;                // TELEMETRY_ flags
+	uint16_t ultrasonicErrors;
+	uint16_t stackMaxUsed;        // stack_max_used()
+	uint16_t stackFree;           // stack_unused()
+	uint16_t drops;               // records dropped so far
+	uint16_t rxErrors;            // uart_rx_errors()
+	uint16_t bandChanges;         // fan_band_transitions_per_hour(), 0 unless FAN_CONTROL_BANDS
+} telemetry_status_t;
+
+typedef struct __attribute__((packed)) {
+	char command;                 // command letter, '?' for a bad line
+	uint8_t result;               // TELEMETRY_OK or the error
+	int16_t value;                // the setting after the command
+} telemetry_reply_t;
+
+_Static_assert(sizeof(telemetry_status_t) <= TELEMETRY_MAX_PAYLOAD, "status record too long");
+
+// Queue one record. Returns 0, and counts a drop, when the UART ring has
+// no room for the whole frame; never waits.
+extern uint8_t telemetry_send(uint8_t type, const void *payload, uint8_t len);
+
+// Records dropped since reset
+extern uint16_t telemetry_drops(void);
+
+#endif // TELEMETRY_H
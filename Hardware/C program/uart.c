@@ -0,0 +1,100 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include "uart.h"
+
+// Single producer (main loop) writes head, single consumer (the UDRE interrupt) writes tail
+static uint8_t txRing[UART_TX_SIZE];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+static uint16_t drops = 0;
+
+// Receive ring the other way round: the RX interrupt writes head, uart_read() tail
+static uint8_t rxRing[UART_RX_SIZE];
+static volatile uint8_t rxHead = 0;
+static volatile uint8_t rxTail = 0;
+static volatile uint16_t rxErrors = 0;
+
+
+ISR(USART0_UDRE_vect) {
+	uint8_t t = txTail;
+
+	if (t == txHead) {
+		UCSR0B &= ~(1 << UDRIE0); // Ring empty, nothing to do until the next write
+		return;
+	}
+	UDR0 = txRing[t];
+	txTail = (t + 1) & (UART_TX_SIZE - 1);
+}
+
+ISR(USART0_RX_vect) {
+	uint8_t status = UCSR0A;
+	uint8_t byte = UDR0; // Reading UDR0 clears the interrupt
+	uint8_t h = rxHead;
+	uint8_t next = (h + 1) & (UART_RX_SIZE - 1);
+
+	if (status & (1 << DOR0)) {
+		rxErrors++; // At least one byte was lost before this one
+	}
+	if ((status & (1 << FE0)) || next == rxTail) {
+		rxErrors++;
+		return;
+	}
+	rxRing[h] = byte;
+	rxHead = next;
+}
+
+void uart_init(void) {
+	UBRR0H = CLOCK_UBRR(CLOCK_UART_BAUD) >> 8;
+	UBRR0L = CLOCK_UBRR(CLOCK_UART_BAUD) & 0xFF;
+	UCSR0A = (1 << U2X0);
+	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+	UCSR0B = (1 << TXEN0) | (1 << RXEN0) | (1 << RXCIE0);
+}
+
+uint8_t uart_tx_free(void) {
+	// One slot stays empty so a full ring is not mistaken for an empty one
+	return (txTail - txHead - 1) & (UART_TX_SIZE - 1);
+}
+
+uint8_t uart_write(const uint8_t *buf, uint8_t len) {
+	if (len > uart_tx_free()) {
+		drops++;
+		return 0;
+	}
+
+	uint8_t h = txHead;
+	while (len--) {
+		txRing[h] = *buf++;
+		h = (h + 1) & (UART_TX_SIZE - 1);
+	}
+	txHead = h;
+	UCSR0B |= (1 << UDRIE0); // The interrupt fires at once if the USART is idle
+
+	return 1;
+}
+
+uint16_t uart_tx_drops(void) {
+	return drops;
+}
+
+uint8_t uart_read(uint8_t *byte) {
+	uint8_t t = rxTail;
+
+	if (t == rxHead) {
+		return 0;
+	}
+	*byte = rxRing[t];
+	rxTail = (t + 1) & (UART_RX_SIZE - 1);
+	return 1;
+}
+
+uint16_t uart_rx_errors(void) {
+	uint16_t n;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		n = rxErrors; // Written by the interrupt, read both bytes together
+	}
+	return n;
+}
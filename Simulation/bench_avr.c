@@ -0,0 +1,389 @@
+/*
+ * Cycle counts of the firmware hot paths on a simulated ATmega64.
+ *
+ * Runs the real firmware image under simavr, drives the LM35, HC-SR04,
+ * buttons and reboot switch from a scenario file, and times every call
+ * of the functions and interrupt handlers listed in probes[] by watching
+ * the program counter and stack pointer. Cycles spent in interrupts that
+ * preempt a call are not charged to it. A table of calls and min/avg/max
+ * cycles is written as tab-separated text, which bench_compare.c checks
+ * against a baseline table.
+ *
+ * Not finished: this has not been built or run against a real simavr
+ * yet, so there is no bench_baseline.tsv. Treat the numbers of a first
+ * run with care.
+ *
+ * simavr has no ATmega64 core. The ATmega128 has the same registers,
+ * vector table and 4 KB of SRAM, so the image runs on that core.
+ *
+ * Build and run on the workstation (avr-gcc, simavr and libelf):
+ *   make bench                      writes bench.tsv
+ *   make bench-baseline             keeps it as bench_baseline.tsv
+ *   make bench-check THRESHOLD=5    fails on a >5% slowdown
+ *
+ *   ./bench_avr [-s scenario] [-o out.tsv] [-f F_CPU] [-p label=symbol] firmware.elf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <libelf.h>
+#include <gelf.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <avr_ioport.h>
+#include <avr_adc.h>
+
+#define BENCH_MCU        "atmega128"   // register compatible stand-in for the ATmega64
+#define BENCH_F_CPU      1000000UL     // clock.h default
+#define BENCH_AVCC_MV    5000
+#define BENCH_MAX_PROBES 32
+#define BENCH_MAX_DEPTH  16
+#define BENCH_MAX_EVENTS 256
+
+#define ECHO_DELAY_US    460           // trigger to echo rise
+#define ECHO_MAX_US      38000         // echo width when nothing is in range
+
+typedef struct {
+	const char *label;     // name in the report
+	const char *symbol;    // function in the ELF
+	uint32_t pc;           // byte address, 0 when the symbol is missing
+	uint64_t calls;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+} probe_t;
+
+typedef struct {
+	probe_t *probe;
+	uint64_t start;        // avr->cycle at entry
+	uint64_t preempted;    // cycles of interrupts taken inside the call
+	uint16_t sp;           // SP at entry, the call has returned once SP is above it
+} frame_t;
+
+typedef struct {
+	uint64_t ms;
+	char what[16];
+	uint32_t value;
+} event_t;
+
+// Hot paths of the current firmware. measureDistance() and adc_read() of
+// the old main loop are now ultrasonic_task() with INT6/Timer3 and
+// temperature_task() with the ADC interrupt.
+static probe_t probes[BENCH_MAX_PROBES] = {
+	{ "loop_pass",                   "scheduler_run" },
+	{ "button_task",                 "button_task" },
+	{ "temperature_task",            "temperature_task" },
+	{ "ultrasonic_task",             "ultrasonic_task" },
+	{ "fan_task",                    "fan_task" },
+	{ "lcd_task",                    "lcd_task" },
+	{ "lcd_display_temperature_fan", "lcd_display_temperature_fan" },
+	{ "lcd_display_graph",           "lcd_display_graph" },
+	{ "lcd_fb_flush",                "lcd_fb_flush" },
+	{ "lcd_puts",                    "lcd_puts" },
+	{ "fmt_fixed1",                  "fmt_fixed1" },
+	{ "isr_int6_echo",               "__vector_7" },
+	{ "isr_int7_reboot",             "__vector_8" },
+	{ "isr_timer1_tick",             "__vector_12" },
+	{ "isr_timer0_ramp",             "__vector_16" },
+	{ "isr_adc",                     "__vector_21" },
+	{ "isr_timer3_timeout",          "__vector_26" }
+};
+static int probeCount;
+
+static frame_t stack[BENCH_MAX_DEPTH];
+static int depth;
+
+static event_t events[BENCH_MAX_EVENTS];
+static int eventCount;
+static uint64_t lengthMs = 60000;
+
+static avr_t *avr;
+static avr_irq_t *echoIrq;
+static uint32_t distanceCm = 100;
+static uint8_t triggerLevel;
+
+
+/*
+ * Symbols
+ */
+
+static int load_symbols(const char *path) {
+	int fd = open(path, O_RDONLY);
+	Elf *elf;
+	Elf_Scn *scn = NULL;
+
+	if (fd < 0 || elf_version(EV_CURRENT) == EV_NONE || (elf = elf_begin(fd, ELF_C_READ, NULL)) == NULL) {
+		return -1;
+	}
+	while ((scn = elf_nextscn(elf, scn)) != NULL) {
+		GElf_Shdr shdr;
+		Elf_Data *data;
+
+		if (gelf_getshdr(scn, &shdr) == NULL || shdr.sh_type != SHT_SYMTAB) {
+			continue;
+		}
+		data = elf_getdata(scn, NULL);
+		for (size_t i = 0; i < shdr.sh_size / shdr.sh_entsize; i++) {
+			GElf_Sym sym;
+			const char *name;
+
+			if (gelf_getsym(data, i, &sym) == NULL || GELF_ST_TYPE(sym.st_info) != STT_FUNC) {
+				continue;
+			}
+			name = elf_strptr(elf, shdr.sh_link, sym.st_name);
+			for (int p = 0; name && p < probeCount; p++) {
+				if (strcmp(name, probes[p].symbol) == 0) {
+					probes[p].pc = sym.st_value;
+				}
+			}
+		}
+	}
+	elf_end(elf);
+	close(fd);
+	return 0;
+}
+
+
+/*
+ * Probes
+ */
+
+static uint16_t sp(void) {
+	return avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+}
+
+static int is_interrupt(const probe_t *p) {
+	return strncmp(p->symbol, "__vector_", 9) == 0;
+}
+
+static void call_done(frame_t *f) {
+	uint64_t cycles = avr->cycle - f->start;
+	probe_t *p = f->probe;
+
+	if (is_interrupt(p)) {
+		for (int i = 0; i < depth; i++) {
+			stack[i].preempted += cycles;
+		}
+	}
+	cycles -= f->preempted;
+
+	if (p->calls == 0 || cycles < p->min) {
+		p->min = cycles;
+	}
+	if (cycles > p->max) {
+		p->max = cycles;
+	}
+	p->total += cycles;
+	p->calls++;
+}
+
+// Called after every instruction
+static void probe_step(void) {
+	uint16_t now = sp();
+
+	while (depth > 0 && now > stack[depth - 1].sp) {
+		depth--;
+		call_done(&stack[depth]);
+	}
+
+	for (int p = 0; p < probeCount; p++) {
+		if (probes[p].pc == 0 || probes[p].pc != avr->pc || depth == BENCH_MAX_DEPTH) {
+			continue;
+		}
+		if (depth > 0 && stack[depth - 1].probe == &probes[p] && stack[depth - 1].sp == now) {
+			continue; // a loop that jumps back to the first instruction
+		}
+		stack[depth++] = (frame_t){ &probes[p], avr->cycle, 0, now };
+	}
+}
+
+
+/*
+ * Stimuli
+ */
+
+static avr_cycle_count_t echo_fall(avr_t *a, avr_cycle_count_t when, void *param) {
+	avr_raise_irq(echoIrq, 0);
+	return 0;
+}
+
+static avr_cycle_count_t echo_rise(avr_t *a, avr_cycle_count_t when, void *param) {
+	uint32_t width = distanceCm * 58;
+
+	avr_raise_irq(echoIrq, 1);
+	avr_cycle_timer_register_usec(a, width > ECHO_MAX_US ? ECHO_MAX_US : width, echo_fall, NULL);
+	return 0;
+}
+
+// The HC-SR04 starts its burst when the trigger pulse ends
+static void trigger_changed(struct avr_irq_t *irq, uint32_t value, void *param) {
+	if (triggerLevel && !value && distanceCm != 0) {
+		avr_cycle_timer_register_usec(avr, ECHO_DELAY_US, echo_rise, NULL);
+	}
+	triggerLevel = value;
+}
+
+static void apply(const event_t *e) {
+	if (strcmp(e->what, "adc0") == 0) {
+		avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0), e->value);
+	} else if (strcmp(e->what, "echo") == 0) {
+		distanceCm = e->value;
+	} else if (strcmp(e->what, "buttons") == 0) {
+		for (int n = 0; n < 4; n++) {
+			// pressed pulls the pin low
+			avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), n), !(e->value & (1 << n)));
+		}
+	} else if (strcmp(e->what, "reboot") == 0) {
+		avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('E'), 7), e->value != 0);
+	}
+}
+
+// Scenario lines: <ms> <adc0|echo|buttons|reboot|end> <value>, # comments
+static int load_scenario(const char *path) {
+	FILE *f = fopen(path, "r");
+	char line[128];
+
+	if (f == NULL) {
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		event_t e;
+		unsigned long long ms;
+		char value[16];
+
+		if (line[0] == '#' || sscanf(line, "%llu %15s %15s", &ms, e.what, value) != 3) {
+			continue;
+		}
+		e.ms = ms;
+		e.value = strtoul(value, NULL, 0);
+		if (strcmp(e.what, "end") == 0) {
+			lengthMs = ms;
+		} else if (eventCount < BENCH_MAX_EVENTS) {
+			events[eventCount++] = e; // kept in file order, which must be by time
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+
+/*
+ * Report
+ */
+
+static int write_report(const char *path, uint32_t fcpu) {
+	FILE *f = strcmp(path, "-") ? fopen(path, "w") : stdout;
+
+	if (f == NULL) {
+		return -1;
+	}
+	fprintf(f, "# mcu %s f_cpu %u simulated_ms %llu\n", BENCH_MCU, fcpu, (unsigned long long)lengthMs);
+	fprintf(f, "# name\tcalls\tmin\tavg\tmax\n");
+	for (int p = 0; p < probeCount; p++) {
+		if (probes[p].calls == 0) {
+			continue; // not in the image, inlined, or never called
+		}
+		fprintf(f, "%s\t%llu\t%llu\t%llu\t%llu\n", probes[p].label,
+		        (unsigned long long)probes[p].calls, (unsigned long long)probes[p].min,
+		        (unsigned long long)(probes[p].total / probes[p].calls), (unsigned long long)probes[p].max);
+	}
+	if (f != stdout) {
+		fclose(f);
+	}
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+	const char *scenario = "bench_scenario.txt";
+	const char *output = "bench.tsv";
+	uint32_t fcpu = BENCH_F_CPU;
+	elf_firmware_t firmware = { 0 };
+	int opt;
+
+	while (probeCount < BENCH_MAX_PROBES && probes[probeCount].label != NULL) {
+		probeCount++;
+	}
+	while ((opt = getopt(argc, argv, "s:o:f:p:")) != -1) {
+		switch (opt) {
+		case 's':
+			scenario = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'f':
+			fcpu = strtoul(optarg, NULL, 0);
+			break;
+		case 'p': {
+			char *eq = strchr(optarg, '=');
+
+			if (eq != NULL && probeCount < BENCH_MAX_PROBES) {
+				*eq = '\0';
+				probes[probeCount++] = (probe_t){ optarg, eq + 1 };
+			}
+			break;
+		}
+		default:
+			optind = argc; // prints the usage below
+			break;
+		}
+	}
+	if (optind != argc - 1) {
+		fprintf(stderr, "usage: %s [-s scenario] [-o out.tsv] [-f F_CPU] [-p label=symbol] firmware.elf\n", argv[0]);
+		return 2;
+	}
+
+	if (elf_read_firmware(argv[optind], &firmware) != 0 || load_symbols(argv[optind]) != 0) {
+		fprintf(stderr, "cannot read %s\n", argv[optind]);
+		return 2;
+	}
+	if (load_scenario(scenario) != 0) {
+		fprintf(stderr, "cannot read %s\n", scenario);
+		return 2;
+	}
+	for (int p = 0; p < probeCount; p++) {
+		if (probes[p].pc == 0) {
+			fprintf(stderr, "%s: no symbol %s, not measured\n", probes[p].label, probes[p].symbol);
+		}
+	}
+
+	avr = avr_make_mcu_by_name(BENCH_MCU);
+	if (avr == NULL) {
+		fprintf(stderr, "simavr has no %s core\n", BENCH_MCU);
+		return 2;
+	}
+	avr_init(avr);
+	avr_load_firmware(avr, &firmware);
+	avr->frequency = fcpu;
+	avr->vcc = avr->avcc = avr->aref = BENCH_AVCC_MV;
+
+	echoIrq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('E'), 6);
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('A'), 6), trigger_changed, NULL);
+
+	uint64_t end = lengthMs * (fcpu / 1000);
+	int next = 0;
+
+	while (avr->cycle < end) {
+		while (next < eventCount && avr->cycle >= events[next].ms * (fcpu / 1000)) {
+			apply(&events[next++]);
+		}
+
+		int state = avr_run(avr);
+		if (state == cpu_Done || state == cpu_Crashed) {
+			fprintf(stderr, "firmware stopped at %llu cycles, pc 0x%04x\n", (unsigned long long)avr->cycle, avr->pc);
+			return 1;
+		}
+		probe_step();
+	}
+
+	if (write_report(output, fcpu) != 0) {
+		fprintf(stderr, "cannot write %s\n", output);
+		return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * Compares two cycle tables written by bench_avr.
+ *
+ * Every hot path of the baseline is looked up in the new table, and any
+ * average that grew by more than the threshold is reported; the run then
+ * fails, which is what makes `make bench-check` stop the build. Paths
+ * missing from the new table are reported but do not fail the run, they
+ * were inlined or are no longer called by the scenario.
+ *
+ * Plain C so it builds and is checked without simavr, see `make check`.
+ *
+ * Build and run on the workstation:
+ *   make bench_compare
+ *   ./bench_compare [-t percent] baseline.tsv new.tsv
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BENCH_MAX_PATHS  64
+
+typedef struct {
+	char name[64];
+	unsigned long long avg;
+} path_t;
+
+static path_t paths[BENCH_MAX_PATHS];
+static int pathCount;
+
+
+// Read the averages of a table into paths[], returns -1 when unreadable
+static int load(const char *file) {
+	FILE *f = fopen(file, "r");
+	char line[256];
+
+	if (f == NULL) {
+		return -1;
+	}
+	pathCount = 0;
+	while (fgets(line, sizeof(line), f) != NULL && pathCount < BENCH_MAX_PATHS) {
+		unsigned long long calls, min, max;
+		path_t *p = &paths[pathCount];
+
+		if (line[0] == '#' || sscanf(line, "%63s %llu %llu %llu %llu", p->name, &calls, &min, &p->avg, &max) != 5) {
+			continue;
+		}
+		pathCount++;
+	}
+	fclose(f);
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+	double threshold = 5.0;
+	FILE *f;
+	char line[256];
+	int regressions = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:")) != -1) {
+		if (opt != 't') {
+			optind = argc; // prints the usage below
+			break;
+		}
+		threshold = atof(optarg);
+	}
+	if (optind != argc - 2) {
+		fprintf(stderr, "usage: %s [-t percent] baseline.tsv new.tsv\n", argv[0]);
+		return 2;
+	}
+
+	if (load(argv[optind + 1]) != 0) {
+		fprintf(stderr, "cannot read %s\n", argv[optind + 1]);
+		return 2;
+	}
+	f = fopen(argv[optind], "r");
+	if (f == NULL) {
+		fprintf(stderr, "no baseline %s, run make bench-baseline on simavr first\n", argv[optind]);
+		return 2;
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char name[64];
+		unsigned long long calls, min, avg, max;
+		int p;
+
+		if (line[0] == '#' || sscanf(line, "%63s %llu %llu %llu %llu", name, &calls, &min, &avg, &max) != 5) {
+			continue;
+		}
+		for (p = 0; p < pathCount && strcmp(name, paths[p].name) != 0; p++) {
+		}
+		if (p == pathCount) {
+			fprintf(stderr, "%s: not measured any more\n", name);
+			continue;
+		}
+
+		double change = avg ? ((double)paths[p].avg - avg) * 100.0 / avg : 0.0;
+
+		if (change > threshold) {
+			fprintf(stderr, "%s: %llu cycles, %llu in the baseline (+%.1f%%)\n", name, paths[p].avg, avg, change);
+			regressions++;
+		}
+	}
+	fclose(f);
+
+	if (regressions) {
+		fprintf(stderr, "%d hot paths slower than %s by more than %.1f%%\n", regressions, argv[optind], threshold);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,442 @@
+/*
+ * The whole firmware running on the workstation.
+ *
+ * main.c and every driver are built unchanged against the register map
+ * and peripheral models in host/, with the room model of pid_sim.c on the
+ * LM35 and a fixed target in front of the HC-SR04. The LCD is printed
+ * whenever a new screen has been sent completely, with custom characters
+ * shown as their CGRAM slot number and full blocks as '#'. Telemetry
+ * frames from USART0 are decoded and checked like a logger would, and
+ * commands can be typed into it from the start of the run.
+ *
+ * Build and run on the workstation:
+ *   make firmware_sim [VARIANT=Hardware]
+ *   ./firmware_sim [-t seconds] [-d cm] [-T start C] [-b buttons] [-r reboot s] [-c command]...
+ *                  [-D s:cm]... [-B s:buttons]... [-l leds] [-f min:max]
+ *                  [-x screen]... [-n bytes] [-p bytes] [-u] [-q]
+ *
+ * -d 0 disconnects the ultrasonic sensor, -b is the pressed button mask
+ * (bit n is PBn, 8 is the fan button), -D and -B change them from the
+ * given second of the run on, -c sends a command line to USART0
+ * (see main.c for the commands; the replies are printed), -u prints every
+ * telemetry record, -q prints only the summary, which makes long runs a
+ * benchmark of the control loop.
+ *
+ * The run fails (exit status 1) on a bad or missing telemetry frame, a
+ * deadline miss, a watchdog reset that -r did not ask for, a fan that
+ * speeds up faster than FAN_RAMP_DUTY_PER_MS allows, an LCD write while
+ * the controller was busy, or when the outputs at the end differ from -l
+ * (PORTC) or -f (fan duty range). -x names text that has to appear on
+ * the LCD during the run, written as printed ("|row 0| |row 1|", any
+ * part of it); -n limits the bytes lcd_fb_flush() sends over the whole
+ * run and -p those sent in one pass of the main loop.
+ * `make check` runs a set of such scenarios.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "clock.h"
+
+#include <avr/io.h>
+
+#include "hal_host.h"
+#include "lcd.h"
+#include "scheduler.h"
+#include "fan.h"
+#include "glyph.h"
+#include "telemetry.h"
+
+// Room model: C dT/dt = load - (h0 + hFan * duty / 255) * (T - outside)
+#define SIM_CAPACITY  600.0   // J/K, sets the time constant of the room
+#define SIM_H0        1.0     // W/K lost without the fan
+#define SIM_HFAN      4.0     // W/K extra at full duty
+#define SIM_OUTSIDE   20.0    // C
+#define SIM_LOAD      20.0    // W, settles at 40 C with the fan off
+#define SIM_NOISE     0.1     // C, peak sensor noise
+#define SIM_LM35      (0.010 / 5.0 * 1024)  // ADC counts per C, 10 mV/C against AVcc
+
+#define SIM_MAX_CHANGES  8
+#define SIM_MAX_SCREENS  8
+#define SIM_SCREEN_LEN   (2 * LCD_DISP_LENGTH + 6)   // "|row 0| |row 1|" and the NUL
+
+// Input change from -D or -B
+typedef struct {
+	uint64_t at;        // cycles
+	char input;         // 'D' distance, 'B' buttons
+	int value;
+} change_t;
+
+static uint64_t endCycles;
+static uint64_t rebootCycles;       // 0 never
+static uint64_t lastCycles;
+static double temp;                 // C in the room
+static double fanEnergy;            // duty-weighted seconds at full speed
+static int quiet;
+static int showUart;
+static int expectLeds = -1;         // PORTC at the end, -1 any
+static int expectDutyMin = 0;       // fan duty range at the end
+static int expectDutyMax = 255;
+static char shown[2][LCD_DISP_LENGTH];
+static const char *expectScreens[SIM_MAX_SCREENS];  // -x, NULL once seen
+static int expectScreenCount;
+static long expectLcdBytes = -1;    // -n, -1 any
+static long expectFlushBytes = -1;  // -p, -1 any
+static uint16_t lastLcdBytes;
+static unsigned maxFlushBytes;
+static change_t changes[SIM_MAX_CHANGES];
+static int changeCount;
+static uint8_t lastDuty;
+static unsigned long fanJumps;
+static struct timespec wallStart;
+
+// Telemetry receiver
+static uint8_t rx[TELEMETRY_MAX_PAYLOAD + 8];
+static size_t rxLen;
+static unsigned long frames, badFrames, lostRecords;
+static int lastSeq = -1;
+
+
+static double seconds(uint64_t cycles) {
+	return (double)cycles / F_CPU;
+}
+
+// Duty the fans actually run at: the L293D inputs on PA0/PA2 and the ramped PWM
+static uint8_t fan_running_duty(void) {
+	return (PORTA & ((1 << PA0) | (1 << PA2))) ? OCR0 : 0;
+}
+
+static char *render_row(char *out, const char *row) {
+	*out++ = '|';
+	for (uint8_t x = 0; x < LCD_DISP_LENGTH; x++) {
+		uint8_t c = row[x];
+
+		if (c == 0xFF) {
+			*out++ = '#';         // full block of the bar graph
+		} else if (c < 16) {
+			*out++ = '0' + (c & 7); // CGRAM glyph, codes 8..15 mirror 0..7
+		} else {
+			*out++ = c >= ' ' && c < 0x7F ? c : '?';
+		}
+	}
+	*out++ = '|';
+	return out;
+}
+
+// Print each new screen once it has been sent completely, and tick off
+// the -x screens it shows
+static void update_lcd(uint64_t cycles) {
+	const char *row0 = host_lcd_row(0);
+	const char *row1 = host_lcd_row(1);
+	char text[SIM_SCREEN_LEN];
+	char *end;
+
+#if LCD_ASYNC
+	if (!lcd_async_idle()) {
+		return; // still being sent
+	}
+#endif
+	if (!memcmp(shown[0], row0, LCD_DISP_LENGTH) && !memcmp(shown[1], row1, LCD_DISP_LENGTH)) {
+		return; // nothing new
+	}
+	memcpy(shown[0], row0, LCD_DISP_LENGTH);
+	memcpy(shown[1], row1, LCD_DISP_LENGTH);
+
+	end = render_row(text, row0);
+	*end++ = ' ';
+	end = render_row(end, row1);
+	*end = '\0';
+
+	for (int i = 0; i < expectScreenCount; i++) {
+		if (expectScreens[i] && strstr(text, expectScreens[i])) {
+			expectScreens[i] = NULL;
+		}
+	}
+	if (!quiet) {
+		printf("%9.3f s  %s  %5.2f C  duty %3u\n", seconds(cycles), text, temp, fan_running_duty());
+	}
+}
+
+static uint8_t crc8(const uint8_t *data, size_t len) {
+	uint8_t crc = 0;
+
+	while (len--) {
+		crc ^= *data++;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+// Undo COBS in place, returns the decoded length or 0 when malformed
+static size_t cobs_decode(uint8_t *buf, size_t len) {
+	size_t in = 0, out = 0;
+
+	while (in < len) {
+		uint8_t code = buf[in++];
+
+		if (code == 0 || in + code - 1 > len) {
+			return 0;
+		}
+		for (uint8_t i = 1; i < code; i++) {
+			buf[out++] = buf[in++];
+		}
+		if (in < len) {
+			buf[out++] = 0; // every run but the last ended in a zero
+		}
+	}
+	return out;
+}
+
+static void print_record(const uint8_t *rec, size_t len) {
+	telemetry_status_t st;
+
+	if (rec[1] == TELEMETRY_REPLY && len - 3 == sizeof(telemetry_reply_t)) {
+		static const char *const results[] = { "ok", "bad line", "unknown command", "bad arguments", "unavailable" };
+		telemetry_reply_t reply;
+
+		memcpy(&reply, &rec[2], sizeof(reply));
+		printf("%9.3f s  #%3u  reply '%c' %s, %d\n", seconds(lastCycles), rec[0], reply.command,
+		       reply.result < 5 ? results[reply.result] : "?", reply.value);
+		return;
+	}
+	if (rec[1] != TELEMETRY_STATUS || len - 3 != sizeof(st)) {
+		printf("%9.3f s  record %u type %u, %zu bytes\n", seconds(lastCycles), rec[0], rec[1], len - 3);
+		return;
+	}
+	memcpy(&st, &rec[2], sizeof(st)); // both little-endian
+	printf("%9.3f s  #%3u  %5u ms  %5.1f C%s  %3u cm%s  buttons %02x  leds %02x  fan %3u/%3u%s"
+	       "  us err %u  stack %u used %u free  drops %u  rx err %u  bands %u/h%s\n",
+	       seconds(lastCycles), rec[0], st.millis, st.temperature / 10.0,
+	       (st.flags & TELEMETRY_TEMP_VALID) ? "" : "!", st.distance, st.occupied ? " home" : "",
+	       st.buttons, st.leds, st.fanDuty, st.fanTarget, (st.flags & TELEMETRY_FANS_ON) ? "" : " off",
+	       st.ultrasonicErrors, st.stackMaxUsed, st.stackFree, st.drops, st.rxErrors, st.bandChanges,
+	       (st.flags & TELEMETRY_REBOOTING) ? "  rebooting" : "");
+}
+
+void host_uart_tx(uint8_t byte) {
+	size_t len;
+
+	if (byte != 0) {
+		if (rxLen < sizeof(rx)) {
+			rx[rxLen] = byte;
+		}
+		rxLen++;
+		return;
+	}
+
+	len = rxLen <= sizeof(rx) ? cobs_decode(rx, rxLen) : 0;
+	rxLen = 0;
+	if (len < 3 || crc8(rx, len - 1) != rx[len - 1]) {
+		badFrames++;
+		return;
+	}
+	frames++;
+	if (lastSeq >= 0) {
+		lostRecords += (uint8_t)(rx[0] - lastSeq - 1);
+	}
+	lastSeq = rx[0];
+	if (!quiet && (showUart || rx[1] != TELEMETRY_STATUS)) {
+		print_record(rx, len);
+	}
+}
+
+void host_stop(const char *reason) {
+	struct timespec wallEnd;
+	double wall;
+	unsigned misses = 0;
+	int failed = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+	wall = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+
+	printf("%s after %.3f s simulated in %.3f s wall (%.0fx real time)\n",
+	       reason, seconds(lastCycles), wall, seconds(lastCycles) / wall);
+	printf("main loop %llu passes (%.2f M/s), %llu interrupts (%.2f M/s)\n",
+	       (unsigned long long)host_loops(), host_loops() / wall / 1e6,
+	       (unsigned long long)host_interrupts(), host_interrupts() / wall / 1e6);
+	printf("room %.2f C, fan duty %u, energy %.3f h at full speed\n", temp, fan_running_duty(), fanEnergy / 3600.0);
+	printf("lcd %u bytes, at most %u in one pass, %u glyph uploads, %lu writes while busy\n",
+	       lcd_fb_bytes_sent(), maxFlushBytes, glyph_uploads(), (unsigned long)host_lcd_busy_writes());
+	printf("telemetry %lu frames, %lu bad, %lu lost in sequence\n", frames, badFrames, lostRecords);
+	printf("deadline misses");
+	for (uint8_t id = 0; id < SCHED_MAX_TASKS; id++) {
+		printf(" %u", scheduler_misses(id));
+		misses += scheduler_misses(id);
+	}
+	printf("\n");
+
+	if (badFrames || lostRecords) {
+		printf("FAIL: %lu bad telemetry frames, %lu records lost\n", badFrames, lostRecords);
+		failed = 1;
+	}
+	if (misses) {
+		printf("FAIL: %u deadline misses\n", misses);
+		failed = 1;
+	}
+	if (host_lcd_busy_writes()) {
+		printf("FAIL: %lu LCD writes while the controller was busy\n", (unsigned long)host_lcd_busy_writes());
+		failed = 1;
+	}
+	for (int i = 0; i < expectScreenCount; i++) {
+		if (expectScreens[i]) {
+			printf("FAIL: the LCD never showed \"%s\"\n", expectScreens[i]);
+			failed = 1;
+		}
+	}
+	if (expectLcdBytes >= 0 && lcd_fb_bytes_sent() > expectLcdBytes) {
+		printf("FAIL: %u bytes sent to the LCD, expected at most %ld\n", lcd_fb_bytes_sent(), expectLcdBytes);
+		failed = 1;
+	}
+	if (expectFlushBytes >= 0 && maxFlushBytes > expectFlushBytes) {
+		printf("FAIL: %u LCD bytes in one pass, expected at most %ld\n", maxFlushBytes, expectFlushBytes);
+		failed = 1;
+	}
+	if (fanJumps) {
+		printf("FAIL: %lu fan starts without the ramp\n", fanJumps);
+		failed = 1;
+	}
+	if (!strcmp(reason, "watchdog reset") && !rebootCycles) {
+		printf("FAIL: unexpected watchdog reset\n");
+		failed = 1;
+	}
+	if (expectLeds >= 0 && (PORTC & 0x1F) != expectLeds) {
+		printf("FAIL: LEDs 0x%02x, expected 0x%02x\n", PORTC & 0x1F, expectLeds);
+		failed = 1;
+	}
+	if (fan_running_duty() < expectDutyMin || fan_running_duty() > expectDutyMax) {
+		printf("FAIL: fan duty %u, expected %d..%d\n", fan_running_duty(), expectDutyMin, expectDutyMax);
+		failed = 1;
+	}
+
+	exit(failed);
+}
+
+void host_update(uint64_t cycles) {
+	double dt = seconds(cycles - lastCycles);
+	uint8_t duty = fan_running_duty();
+	double h = SIM_H0 + SIM_HFAN * duty / 255.0;
+	double noisy;
+
+	// Stopping is immediate, but speeding up must follow the ramp
+	if (duty > lastDuty + FAN_RAMP_DUTY_PER_MS * (seconds(cycles - lastCycles) * 1000.0 + 1.0)) {
+		if (!quiet) {
+			printf("%9.3f s  fan jumped from duty %u to %u\n", seconds(cycles), lastDuty, duty);
+		}
+		fanJumps++;
+	}
+	lastDuty = duty;
+
+	temp += (SIM_LOAD - h * (temp - SIM_OUTSIDE)) * dt / SIM_CAPACITY;
+	fanEnergy += duty / 255.0 * dt;
+	lastCycles = cycles;
+
+	noisy = temp + SIM_NOISE * (2.0 * rand() / RAND_MAX - 1.0);
+	host_inputs.adc = noisy <= 0 ? 0 : (noisy * SIM_LM35 >= 1023 ? 1023 : (uint16_t)(noisy * SIM_LM35 + 0.5));
+	host_inputs.reboot = rebootCycles && cycles >= rebootCycles;
+	for (int i = 0; i < changeCount; i++) {
+		if (changes[i].at && changes[i].at <= cycles) {
+			if (changes[i].input == 'D') {
+				host_inputs.distance_cm = changes[i].value;
+			} else {
+				host_inputs.buttons = changes[i].value;
+			}
+			changes[i].at = 0; // done
+		}
+	}
+
+	if ((uint16_t)(lcd_fb_bytes_sent() - lastLcdBytes) > maxFlushBytes) {
+		maxFlushBytes = (uint16_t)(lcd_fb_bytes_sent() - lastLcdBytes);
+	}
+	lastLcdBytes = lcd_fb_bytes_sent();
+	update_lcd(cycles);
+	if (cycles >= endCycles) {
+		host_stop("end of run");
+	}
+}
+
+int main(int argc, char **argv) {
+	double length = 60.0;
+	double reboot = 0.0;
+	double at;
+	int opt;
+
+	temp = 30.0;
+	host_inputs.distance_cm = 100;
+
+	while ((opt = getopt(argc, argv, "t:d:T:b:r:c:D:B:l:f:x:n:p:uq")) != -1) {
+		switch (opt) {
+		case 't':
+			length = atof(optarg);
+			break;
+		case 'd':
+			host_inputs.distance_cm = atoi(optarg);
+			break;
+		case 'T':
+			temp = atof(optarg);
+			break;
+		case 'b':
+			host_inputs.buttons = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			reboot = atof(optarg);
+			break;
+		case 'c':
+			host_uart_send((const uint8_t *)optarg, strlen(optarg));
+			host_uart_send((const uint8_t *)"\n", 1);
+			break;
+		case 'D':
+		case 'B':
+			if (changeCount == SIM_MAX_CHANGES || sscanf(optarg, "%lf:%i", &at, &changes[changeCount].value) != 2 || at <= 0) {
+				fprintf(stderr, "-%c wants seconds:value, at most %d of them\n", opt, SIM_MAX_CHANGES);
+				return 2;
+			}
+			changes[changeCount].at = (uint64_t)(at * F_CPU);
+			changes[changeCount++].input = opt;
+			break;
+		case 'l':
+			expectLeds = strtol(optarg, NULL, 0);
+			break;
+		case 'f':
+			if (sscanf(optarg, "%d:%d", &expectDutyMin, &expectDutyMax) != 2) {
+				expectDutyMax = expectDutyMin;
+			}
+			break;
+		case 'x':
+			if (expectScreenCount == SIM_MAX_SCREENS || strlen(optarg) >= SIM_SCREEN_LEN) {
+				fprintf(stderr, "-x wants part of a screen, at most %d of them\n", SIM_MAX_SCREENS);
+				return 2;
+			}
+			expectScreens[expectScreenCount++] = optarg;
+			break;
+		case 'n':
+			expectLcdBytes = atol(optarg);
+			break;
+		case 'p':
+			expectFlushBytes = atol(optarg);
+			break;
+		case 'u':
+			showUart = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-t seconds] [-d cm] [-T start C] [-b buttons] [-r reboot s] [-c command]...\n"
+			        "       [-D s:cm]... [-B s:buttons]... [-l leds] [-f min:max]\n"
+			        "       [-x screen]... [-n bytes] [-p bytes] [-u] [-q]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	endCycles = (uint64_t)(length * F_CPU);
+	rebootCycles = (uint64_t)(reboot * F_CPU);
+	srand(1);
+	clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+	return firmware_main();
+}
@@ -0,0 +1,34 @@
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+/*
+ * Host build stand-in for <avr/eeprom.h>. EEMEM variables are ordinary
+ * (zeroed, so never a valid record) variables and are read and written
+ * in place. Nothing survives the end of the run.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#define EEMEM
+
+static inline void eeprom_read_block(void *dst, const void *src, size_t n) {
+	memcpy(dst, src, n);
+}
+
+static inline void eeprom_update_block(const void *src, void *dst, size_t n) {
+	memcpy(dst, src, n);
+}
+
+static inline void eeprom_write_block(const void *src, void *dst, size_t n) {
+	memcpy(dst, src, n);
+}
+
+static inline uint8_t eeprom_read_byte(const uint8_t *p) {
+	return *p;
+}
+
+static inline void eeprom_update_byte(uint8_t *p, uint8_t value) {
+	*p = value;
+}
+
+#endif // HOST_AVR_EEPROM_H
@@ -0,0 +1,18 @@
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+/*
+ * Host build stand-in for <avr/interrupt.h>.
+ *
+ * An ISR becomes an ordinary function named after its vector, which
+ * hal_host.c calls when the simulated peripheral raises it. Interrupts
+ * are only taken inside hal_idle(), between two passes of the main loop,
+ * so sei()/cli() just keep the I flag for the simulator to look at.
+ */
+
+#include <avr/io.h>
+
+#define ISR(vector, ...)  void vector(void); void vector(void)
+#define sei()             (SREG |= 0x80)
+#define cli()             (SREG &= ~0x80)
+
+#endif // HOST_AVR_INTERRUPT_H
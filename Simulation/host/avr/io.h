@@ -0,0 +1,251 @@
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+/*
+ * Host build stand-in for <avr/io.h>, ATmega64 register map.
+ *
+ * Every register is a byte of host_io at its data memory address, so
+ * address arithmetic such as DDR(x) and PIN(x) in lcd.c still works and
+ * 16-bit registers overlay their low and high bytes like on the chip.
+ * Only the registers and bits the firmware uses are listed. hal_host.c
+ * owns the storage and plays the peripherals behind it.
+ */
+
+#include <inttypes.h>
+
+#define __AVR_ATmega64__  1
+
+typedef union {
+	uint8_t b[0x100];
+	uint16_t w[0x80];
+} host_io_t;
+
+extern volatile host_io_t host_io;
+
+#define _SFR_MEM8(a)   (host_io.b[(a)])
+#define _SFR_MEM16(a)  (host_io.w[(a) / 2])
+#define _SFR_IO8(a)    _SFR_MEM8((a) + 0x20)
+#define _SFR_IO16(a)   _SFR_MEM16((a) + 0x20)
+#define _BV(bit)       (1 << (bit))
+
+#define RAMEND   0x10FF
+
+// Ports
+#define PINF     _SFR_IO8(0x00)
+#define PINE     _SFR_IO8(0x01)
+#define DDRE     _SFR_IO8(0x02)
+#define PORTE    _SFR_IO8(0x03)
+#define PIND     _SFR_IO8(0x10)
+#define DDRD     _SFR_IO8(0x11)
+#define PORTD    _SFR_IO8(0x12)
+#define PINC     _SFR_IO8(0x13)
+#define DDRC     _SFR_IO8(0x14)
+#define PORTC    _SFR_IO8(0x15)
+#define PINB     _SFR_IO8(0x16)
+#define DDRB     _SFR_IO8(0x17)
+#define PORTB    _SFR_IO8(0x18)
+#define PINA     _SFR_IO8(0x19)
+#define DDRA     _SFR_IO8(0x1A)
+#define PORTA    _SFR_IO8(0x1B)
+#define DDRF     _SFR_MEM8(0x61)
+#define PORTF    _SFR_MEM8(0x62)
+#define PING     _SFR_MEM8(0x63)
+#define DDRG     _SFR_MEM8(0x64)
+#define PORTG    _SFR_MEM8(0x65)
+
+// ADC
+#define ADC      _SFR_IO16(0x04)
+#define ADCW     ADC
+#define ADCL     _SFR_IO8(0x04)
+#define ADCH     _SFR_IO8(0x05)
+#define ADCSRA   _SFR_IO8(0x06)
+#define ADMUX    _SFR_IO8(0x07)
+
+// USART0
+#define UBRR0L   _SFR_IO8(0x09)
+#define UCSR0B   _SFR_IO8(0x0A)
+#define UCSR0A   _SFR_IO8(0x0B)
+#define UDR0     _SFR_IO8(0x0C)
+#define UBRR0H   _SFR_MEM8(0x90)
+#define UCSR0C   _SFR_MEM8(0x95)
+
+// Timers, watchdog, interrupts
+#define SFIOR    _SFR_IO8(0x20)
+#define WDTCR    _SFR_IO8(0x21)
+#define OCR2     _SFR_IO8(0x23)
+#define TCNT2    _SFR_IO8(0x24)
+#define TCCR2    _SFR_IO8(0x25)
+#define ICR1     _SFR_IO16(0x26)
+#define OCR1B    _SFR_IO16(0x28)
+#define OCR1A    _SFR_IO16(0x2A)
+#define TCNT1    _SFR_IO16(0x2C)
+#define TCCR1B   _SFR_IO8(0x2E)
+#define TCCR1A   _SFR_IO8(0x2F)
+#define OCR0     _SFR_IO8(0x31)
+#define TCNT0    _SFR_IO8(0x32)
+#define TCCR0    _SFR_IO8(0x33)
+#define MCUCSR   _SFR_IO8(0x34)
+#define MCUCR    _SFR_IO8(0x35)
+#define TIFR     _SFR_IO8(0x36)
+#define TIMSK    _SFR_IO8(0x37)
+#define EIFR     _SFR_IO8(0x38)
+#define EIMSK    _SFR_IO8(0x39)
+#define EICRB    _SFR_IO8(0x3A)
+#define SP       _SFR_IO16(0x3D)
+#define SPL      _SFR_IO8(0x3D)
+#define SPH      _SFR_IO8(0x3E)
+#define SREG     _SFR_IO8(0x3F)
+#define EICRA    _SFR_MEM8(0x6A)
+#define ETIFR    _SFR_MEM8(0x7C)
+#define ETIMSK   _SFR_MEM8(0x7D)
+#define ICR3     _SFR_MEM16(0x80)
+#define OCR3C    _SFR_MEM16(0x82)
+#define OCR3B    _SFR_MEM16(0x84)
+#define OCR3A    _SFR_MEM16(0x86)
+#define TCNT3    _SFR_MEM16(0x88)
+#define TCCR3B   _SFR_MEM8(0x8A)
+#define TCCR3A   _SFR_MEM8(0x8B)
+
+// Port pins
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define PE0 0
+#define PE1 1
+#define PE2 2
+#define PE3 3
+#define PE4 4
+#define PE5 5
+#define PE6 6
+#define PE7 7
+#define PF0 0
+#define PG0 0
+#define PG1 1
+#define PG2 2
+#define PG3 3
+#define PG4 4
+
+// ADMUX, ADCSRA
+#define REFS1  7
+#define REFS0  6
+#define ADLAR  5
+#define ADEN   7
+#define ADSC   6
+#define ADFR   5
+#define ADIF   4
+#define ADIE   3
+#define ADPS2  2
+#define ADPS1  1
+#define ADPS0  0
+
+// UCSR0A, UCSR0B, UCSR0C
+#define RXC0    7
+#define TXC0    6
+#define UDRE0   5
+#define FE0     4
+#define DOR0    3
+#define UPE0    2
+#define U2X0    1
+#define MPCM0   0
+#define RXCIE0  7
+#define TXCIE0  6
+#define UDRIE0  5
+#define RXEN0   4
+#define TXEN0   3
+#define UCSZ02  2
+#define UMSEL0  6
+#define UPM01   5
+#define UPM00   4
+#define USBS0   3
+#define UCSZ01  2
+#define UCSZ00  1
+#define UCPOL0  0
+
+// TCCR0, TCCR2
+#define FOC0   7
+#define WGM00  6
+#define COM01  5
+#define COM00  4
+#define WGM01  3
+#define CS02   2
+#define CS01   1
+#define CS00   0
+#define FOC2   7
+#define WGM20  6
+#define COM21  5
+#define COM20  4
+#define WGM21  3
+#define CS22   2
+#define CS21   1
+#define CS20   0
+
+// TCCR1B, TCCR3B
+#define WGM13  4
+#define WGM12  3
+#define CS12   2
+#define CS11   1
+#define CS10   0
+#define WGM33  4
+#define WGM32  3
+#define CS32   2
+#define CS31   1
+#define CS30   0
+
+// TIMSK, TIFR, ETIMSK, ETIFR
+#define OCIE2   7
+#define TOIE2   6
+#define TICIE1  5
+#define OCIE1A  4
+#define OCIE1B  3
+#define TOIE1   2
+#define OCIE0   1
+#define TOIE0   0
+#define OCF1A   4
+#define TOV0    0
+#define OCIE3A  4
+#define OCF3A   4
+
+// EICRB, EIMSK, EIFR
+#define ISC71  7
+#define ISC70  6
+#define ISC61  5
+#define ISC60  4
+#define INT7   7
+#define INT6   6
+#define INTF7  7
+#define INTF6  6
+
+// WDTCR, MCUCSR
+#define WDCE   4
+#define WDE    3
+#define WDRF   3
+
+#endif // HOST_AVR_IO_H
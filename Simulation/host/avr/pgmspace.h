@@ -0,0 +1,19 @@
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+/*
+ * Host build stand-in for <avr/pgmspace.h>: flash and RAM share one
+ * address space, so the _P functions are the plain ones.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)            (s)
+#define pgm_read_byte(p)   (*(const uint8_t *)(p))
+#define pgm_read_word(p)   (*(const uint16_t *)(p))
+#define pgm_read_ptr(p)    (*(const void * const *)(p))
+#define memcpy_P           memcpy
+#define strlen_P           strlen
+
+#endif // HOST_AVR_PGMSPACE_H
@@ -0,0 +1,25 @@
+#ifndef HOST_AVR_WDT_H
+#define HOST_AVR_WDT_H
+/*
+ * Host build stand-in for <avr/wdt.h>. Arming the watchdog ends the
+ * simulated run, as the firmware only does it to reset the board.
+ */
+
+#include <inttypes.h>
+
+#define WDTO_15MS   0
+#define WDTO_30MS   1
+#define WDTO_60MS   2
+#define WDTO_120MS  3
+#define WDTO_250MS  4
+#define WDTO_500MS  5
+#define WDTO_1S     6
+#define WDTO_2S     7
+
+extern void host_wdt_enable(uint8_t timeout);
+
+#define wdt_enable(timeout)  host_wdt_enable(timeout)
+#define wdt_disable()
+#define wdt_reset()
+
+#endif // HOST_AVR_WDT_H
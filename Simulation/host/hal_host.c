@@ -0,0 +1,521 @@
+/*
+ * Peripheral models behind the host register map, see hal_host.h.
+ *
+ * Each model looks at the registers the firmware wrote since the last
+ * call, works out when it next raises an interrupt, and hal_idle() jumps
+ * to the earliest of those. Interrupts are only taken there, so handlers
+ * never preempt a task half way: the host build checks the logic and the
+ * timing of events, not races between the main loop and the ISRs.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "clock.h"
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+
+#include "hal.h"
+#include "hal_host.h"
+#include "lcd.h"
+#include "hcsr04.h"
+#include "buttons.h"
+
+#define CYCLES_PER_MS   (F_CPU / 1000UL)
+#define SREG_I          0x80
+
+#define LCD_EXEC_US     53       // HD44780 busy time after a write, slowest (190 kHz) oscillator
+#define LCD_CLEAR_US    2160     // the same after clear display and return home
+#define LCD_STROBE_CYCLES 8      // CPU time of one enable pulse with the code around it
+
+#define ECHO_DELAY_US   460      // trigger to echo rise, 8 bursts at 40 kHz plus processing
+#define ECHO_MAX_US     38000    // echo width when nothing is in range
+
+// Interrupt vectors, weak so a build without one of the drivers still links
+extern void TIMER0_OVF_vect(void) __attribute__((weak));
+extern void TIMER1_COMPA_vect(void) __attribute__((weak));
+extern void TIMER3_COMPA_vect(void) __attribute__((weak));
+extern void ADC_vect(void) __attribute__((weak));
+extern void INT6_vect(void) __attribute__((weak));
+extern void INT7_vect(void) __attribute__((weak));
+extern void USART0_UDRE_vect(void) __attribute__((weak));
+extern void USART0_RX_vect(void) __attribute__((weak));
+
+volatile host_io_t host_io;
+host_inputs_t host_inputs;
+
+static uint64_t now;                // CPU cycles since reset
+static uint64_t loops;
+static uint64_t interrupts;
+
+// Periodic sources, the cycle of the next event or 0 while stopped
+static uint64_t timer0Next;
+static uint64_t timer1Next;
+static uint64_t adcNext;
+
+// Timer3 runs free and is only read, TCNT3 follows from its start cycle
+static uint8_t timer3Running;
+static uint64_t timer3Start;
+static uint64_t timer3Match;        // next OCR3A compare match
+
+// HC-SR04 echo edges in flight, 0 when none is pending
+static uint64_t echoRise;
+static uint64_t echoFall;
+
+static uint8_t rebootLevel;
+
+// USART0 transmitter, free again from this cycle on
+static uint64_t uartReady;
+
+// Bytes on their way in through RXD0
+static uint8_t uartRx[1024];
+static uint16_t uartRxLen;
+static uint16_t uartRxPos;
+static uint64_t uartRxNext;         // cycle the next byte is complete, 0 when idle
+
+// HD44780, just enough of it for what lcd.c sends
+static char lcdDdram[0x80] = { [0 ... 0x7F] = ' ' };
+static uint8_t lcdCgram[0x40];
+static uint8_t lcdAddr;
+static uint8_t lcdCgAddr;
+static uint8_t lcdInCgram;          // data goes to CGRAM after a set CGRAM address
+static uint8_t lcdFourBit;          // interface switched to 4 bits by a function set
+#if !LCD_IO_8BIT
+static int16_t lcdHigh = -1;        // high nibble of a 4-bit write, -1 when none
+#endif
+static uint8_t lcdReadLow;          // next 4-bit read returns the low nibble
+static uint64_t lcdBusyUntil;       // cycle the last instruction is done
+static uint8_t lcdWriteBusy;        // part of the current write came while busy
+static uint32_t lcdBusyWrites;      // writes the controller ignored
+
+
+uint64_t host_cycles(void) {
+	return now;
+}
+
+uint64_t host_loops(void) {
+	return loops;
+}
+
+uint64_t host_interrupts(void) {
+	return interrupts;
+}
+
+const char *host_lcd_row(uint8_t row) {
+	return &lcdDdram[row ? LCD_START_LINE2 : LCD_START_LINE1];
+}
+
+uint32_t host_lcd_busy_writes(void) {
+	return lcdBusyWrites;
+}
+
+void host_uart_send(const uint8_t *data, uint16_t len) {
+	while (len-- && uartRxLen < sizeof(uartRx)) {
+		uartRx[uartRxLen++] = *data++;
+	}
+}
+
+void host_wdt_enable(uint8_t timeout) {
+	(void)timeout;
+	host_stop("watchdog reset");
+}
+
+static void interrupt(void (*vector)(void)) {
+	if (vector == NULL || !(SREG & SREG_I)) {
+		return;
+	}
+	SREG &= ~SREG_I;
+	vector();
+	SREG |= SREG_I;
+	interrupts++;
+}
+
+
+/*
+ * Timers and ADC
+ */
+
+static uint16_t timer0_prescale(void) {
+	static const uint16_t div[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+	return div[TCCR0 & 0x07];
+}
+
+// Timer1 and Timer3 share the clock select encoding
+static uint16_t timer16_prescale(uint8_t tccrb) {
+	static const uint16_t div[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+	return div[tccrb & 0x07];
+}
+
+static uint32_t timer0_period(void) {
+	return 256UL * timer0_prescale();
+}
+
+static uint32_t timer1_period(void) {
+	uint32_t top = (TCCR1B & _BV(WGM12)) ? OCR1A : 0xFFFF;
+	return (top + 1) * timer16_prescale(TCCR1B);
+}
+
+static uint32_t adc_period(void) {
+	uint8_t adps = ADCSRA & 0x07;
+
+	if (!(ADCSRA & _BV(ADEN)) || !(ADCSRA & _BV(ADSC))) {
+		return 0;
+	}
+	return 13UL << (adps ? adps : 1);
+}
+
+// Start or stop a periodic source to match its registers
+static void periodic_sync(uint64_t *next, uint32_t period) {
+	if (period == 0) {
+		*next = 0;
+	} else if (*next == 0) {
+		*next = now + period;
+	}
+}
+
+// Returns 1 when the source is due, and moves it past 'now'. Like the
+// interrupt flag it stands for, periods missed in a long delay fire once.
+static uint8_t periodic_due(uint64_t *next, uint32_t period) {
+	if (*next == 0 || *next > now) {
+		return 0;
+	}
+	*next += ((now - *next) / period + 1) * period;
+	return 1;
+}
+
+static uint16_t timer3_count(uint64_t at) {
+	return (uint16_t)((at - timer3Start) / timer16_prescale(TCCR3B));
+}
+
+static void timer3_sync(void) {
+	uint16_t div = timer16_prescale(TCCR3B);
+
+	if (div == 0) {
+		timer3Running = 0;
+		return;
+	}
+	if (!timer3Running) {
+		timer3Running = 1;
+		timer3Start = now;
+	}
+
+	// First count after the current one that equals OCR3A
+	uint64_t count = (now - timer3Start) / div;
+	uint32_t ahead = (uint16_t)(OCR3A - (uint16_t)count - 1) + 1UL;
+	timer3Match = timer3Start + (count + ahead) * div;
+}
+
+// Let the firmware read the counters as they stand at 'now'
+static void counters(void) {
+	if (timer1Next) {
+		TCNT1 = (timer1_period() - (timer1Next - now)) / timer16_prescale(TCCR1B);
+	}
+	if (timer3Running) {
+		TCNT3 = timer3_count(now);
+	}
+}
+
+
+/*
+ * HC-SR04 and the other inputs
+ */
+
+static void ping(void) {
+	uint32_t width = host_inputs.distance_cm * 58UL;
+
+	if (host_inputs.distance_cm == 0) {
+		return; // nothing connected, the echo never rises
+	}
+	if (width > ECHO_MAX_US) {
+		width = ECHO_MAX_US;
+	}
+	echoRise = now + ECHO_DELAY_US * CLOCK_CYCLES_PER_US;
+	echoFall = echoRise + width * CLOCK_CYCLES_PER_US;
+}
+
+static void echo_edge(uint64_t at, uint8_t level) {
+	if (level) {
+		ECHO_PINS |= _BV(ECHO_PIN);
+	} else {
+		ECHO_PINS &= ~_BV(ECHO_PIN);
+	}
+	if (EIMSK & _BV(INT6)) {
+		if (timer3Running) {
+			TCNT3 = timer3_count(at); // as if the handler ran right at the edge
+		}
+		interrupt(INT6_vect);
+	}
+}
+
+static void inputs(void) {
+	PINB = (PINB & ~BUTTON_MASK) | (~host_inputs.buttons & BUTTON_MASK); // pressed pulls low
+
+	if (host_inputs.reboot && !rebootLevel && (EIMSK & _BV(INT7))) {
+		interrupt(INT7_vect); // rising edge, the only sense main.c sets up
+	}
+	rebootLevel = host_inputs.reboot;
+}
+
+
+/*
+ * USART0
+ */
+
+// One frame of start, 8 data and stop bits
+static uint32_t uart_frame(void) {
+	uint16_t ubrr = ((UBRR0H & 0x0F) << 8) | UBRR0L;
+
+	return 10UL * ((UCSR0A & _BV(U2X0)) ? 8 : 16) * (ubrr + 1);
+}
+
+static uint8_t uart_armed(void) {
+	return (UCSR0B & (_BV(TXEN0) | _BV(UDRIE0))) == (_BV(TXEN0) | _BV(UDRIE0));
+}
+
+static void uart_tx(void) {
+	if (!uart_armed() || uartReady > now) {
+		return;
+	}
+	interrupt(USART0_UDRE_vect);
+	// uart.c clears UDRIE0 instead of writing when it has nothing to send
+	if (UCSR0B & _BV(UDRIE0)) {
+		host_uart_tx(UDR0);
+		uartReady = now + uart_frame();
+	}
+}
+
+static void uart_rx_sync(void) {
+	if (!(UCSR0B & _BV(RXEN0)) || uartRxPos == uartRxLen) {
+		uartRxNext = 0;
+	} else if (uartRxNext == 0) {
+		uartRxNext = now + uart_frame();
+	}
+}
+
+static void uart_rx(void) {
+	if (uartRxNext == 0 || uartRxNext > now) {
+		return;
+	}
+	UDR0 = uartRx[uartRxPos++];
+	UCSR0A |= _BV(RXC0);
+	if (UCSR0B & _BV(RXCIE0)) {
+		interrupt(USART0_RX_vect);
+	}
+	UCSR0A &= ~_BV(RXC0); // read by the handler, or lost like an overrun
+	uartRxNext = (uartRxPos < uartRxLen) ? uartRxNext + uart_frame() : 0;
+}
+
+
+/*
+ * HD44780
+ */
+
+static volatile uint8_t *pin_of(volatile uint8_t *port) {
+	return (port == &PORTF) ? &PINF : port - 2;
+}
+
+#if LCD_IO_8BIT
+static uint8_t lcd_bus_get(void) {
+	return LCD_DATA_PORT;
+}
+
+static void lcd_bus_put(uint8_t value) {
+	*pin_of(&LCD_DATA_PORT) = value;
+}
+#else
+static void lcd_pin_put(volatile uint8_t *port, uint8_t pin, uint8_t level) {
+	if (level) {
+		*pin_of(port) |= _BV(pin);
+	} else {
+		*pin_of(port) &= ~_BV(pin);
+	}
+}
+
+static uint8_t lcd_bus_get(void) {
+	return ((LCD_DATA0_PORT >> LCD_DATA0_PIN) & 1)
+	     | ((LCD_DATA1_PORT >> LCD_DATA1_PIN) & 1) << 1
+	     | ((LCD_DATA2_PORT >> LCD_DATA2_PIN) & 1) << 2
+	     | ((LCD_DATA3_PORT >> LCD_DATA3_PIN) & 1) << 3;
+}
+
+static void lcd_bus_put(uint8_t nibble) {
+	lcd_pin_put(&LCD_DATA0_PORT, LCD_DATA0_PIN, nibble & 0x01);
+	lcd_pin_put(&LCD_DATA1_PORT, LCD_DATA1_PIN, nibble & 0x02);
+	lcd_pin_put(&LCD_DATA2_PORT, LCD_DATA2_PIN, nibble & 0x04);
+	lcd_pin_put(&LCD_DATA3_PORT, LCD_DATA3_PIN, nibble & 0x08);
+}
+#endif
+
+static void lcd_byte(uint8_t rs, uint8_t value) {
+	uint8_t slow = !rs && (value == 0x01 || (value & 0xFE) == 0x02); // clear display, return home
+
+	// A write while the controller is still busy is lost
+	if (lcdWriteBusy) {
+		lcdWriteBusy = 0;
+		lcdBusyWrites++;
+		return;
+	}
+	lcdBusyUntil = now + (slow ? LCD_CLEAR_US : LCD_EXEC_US) * CLOCK_CYCLES_PER_US;
+
+	if (rs) {
+		if (lcdInCgram) {
+			lcdCgram[lcdCgAddr++ & 0x3F] = value;
+		} else {
+			lcdDdram[lcdAddr] = value;
+			lcdAddr = (lcdAddr + 1) & 0x7F;
+		}
+	} else if (value & 0x80) {
+		lcdInCgram = 0;
+		lcdAddr = value & 0x7F;
+	} else if (value & 0x40) {
+		lcdInCgram = 1;
+		lcdCgAddr = value & 0x3F;
+	} else if (value & 0x20) {
+		lcdFourBit = !(value & 0x10);
+	} else if (value == 0x01) {
+		memset(lcdDdram, ' ', sizeof(lcdDdram));
+		lcdInCgram = 0;
+		lcdAddr = 0;
+	} else if ((value & 0xFE) == 0x02) {
+		lcdInCgram = 0;
+		lcdAddr = 0;
+	}
+	// entry mode, display control and shifts keep the defaults lcd.c uses
+}
+
+static uint8_t lcd_byte_read(uint8_t rs) {
+	if (rs) {
+		return lcdDdram[lcdAddr];
+	}
+	return lcdAddr | (now < lcdBusyUntil ? 1 << LCD_BUSY : 0);
+}
+
+void hal_strobe(void) {
+	uint8_t rs = (LCD_RS_PORT & _BV(LCD_RS_PIN)) != 0;
+
+	if (!(LCD_E_PORT & _BV(LCD_E_PIN))) {
+		return; // the delay with E low between two pulses
+	}
+	now += LCD_STROBE_CYCLES; // so a busy flag poll sees time pass
+	counters();
+
+	if (LCD_RW_PORT & _BV(LCD_RW_PIN)) {
+#if LCD_IO_8BIT
+		lcd_bus_put(lcd_byte_read(rs));
+#else
+		uint8_t value = lcd_byte_read(rs);
+
+		lcd_bus_put(lcdReadLow ? value & 0x0F : value >> 4);
+		lcdReadLow = !lcdReadLow;
+#endif
+		return;
+	}
+
+	lcdReadLow = 0;
+	if (now < lcdBusyUntil) {
+		lcdWriteBusy = 1;
+	}
+#if LCD_IO_8BIT
+	lcd_byte(rs, lcd_bus_get());
+#else
+	uint8_t nibble = lcd_bus_get();
+
+	if (!lcdFourBit) {
+		lcd_byte(rs, nibble << 4); // still in 8-bit mode after power-up, DB0..3 unconnected
+	} else if (lcdHigh < 0) {
+		lcdHigh = nibble;
+	} else {
+		lcd_byte(rs, (lcdHigh << 4) | nibble);
+		lcdHigh = -1;
+	}
+#endif
+}
+
+
+/*
+ * Time
+ */
+
+void hal_delay_cycles(uint32_t cycles) {
+	// A delay with the trigger high is the HC-SR04 trigger pulse
+	uint8_t trigger = (TRIGGER_DDR & TRIGGER_PORT & _BV(TRIGGER_PIN)) != 0;
+
+	now += cycles;
+	if (trigger) {
+		ping();
+	}
+	counters();
+}
+
+static void sooner(uint64_t *next, uint64_t at, uint8_t armed) {
+	if (armed && at != 0 && at < *next) {
+		*next = at;
+	}
+}
+
+void hal_idle(void) {
+	uint64_t next = UINT64_MAX;
+
+	loops++;
+
+	// Pick up what the tasks changed in the registers
+	periodic_sync(&timer0Next, timer0_period());
+	periodic_sync(&timer1Next, timer1_period());
+	periodic_sync(&adcNext, adc_period());
+	timer3_sync();
+	uart_rx_sync();
+
+	sooner(&next, timer0Next, TIMSK & _BV(TOIE0));
+	sooner(&next, timer1Next, TIMSK & _BV(OCIE1A));
+	sooner(&next, adcNext, ADCSRA & _BV(ADIE));
+	sooner(&next, timer3Match, timer3Running && (ETIMSK & _BV(OCIE3A)));
+	sooner(&next, echoRise, 1);
+	sooner(&next, echoFall, echoRise == 0);
+	sooner(&next, uartReady > now ? uartReady : now, uart_armed());
+	sooner(&next, uartRxNext, 1);
+	if (next == UINT64_MAX) {
+		next = now + CYCLES_PER_MS; // nothing armed, look again in a millisecond
+	}
+	if (next > now) {
+		now = next;
+	}
+
+	host_update(now);
+	inputs();
+
+	if (echoRise && echoRise <= now) {
+		echo_edge(echoRise, 1);
+		echoRise = 0;
+	}
+	if (echoFall && echoRise == 0 && echoFall <= now) {
+		echo_edge(echoFall, 0);
+		echoFall = 0;
+	}
+	if (timer3Running && timer3Match <= now) {
+		ETIFR |= _BV(OCF3A);
+		if (ETIMSK & _BV(OCIE3A)) {
+			ETIFR &= ~_BV(OCF3A);
+			interrupt(TIMER3_COMPA_vect);
+		}
+	}
+	if (periodic_due(&timer1Next, timer1_period()) && (TIMSK & _BV(OCIE1A))) {
+		interrupt(TIMER1_COMPA_vect);
+	}
+	if (periodic_due(&timer0Next, timer0_period()) && (TIMSK & _BV(TOIE0))) {
+		interrupt(TIMER0_OVF_vect);
+	}
+	if (periodic_due(&adcNext, adc_period())) {
+		ADC = host_inputs.adc & 0x3FF;
+		if (!(ADCSRA & _BV(ADFR))) {
+			ADCSRA &= ~_BV(ADSC); // single conversion done
+		}
+		if (ADCSRA & _BV(ADIE)) {
+			interrupt(ADC_vect);
+		}
+	}
+	uart_rx();
+	uart_tx();
+
+	counters();
+}
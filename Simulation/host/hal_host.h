@@ -0,0 +1,62 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+/*
+ * Simulated smart-house board for the host build of the firmware.
+ *
+ * hal_host.c plays the peripherals the firmware uses on top of the
+ * register array from avr/io.h: Timer0/1/3, the free-running ADC, INT6
+ * and INT7, USART0, the HC-SR04 and the HD44780 on the LCD port, busy
+ * flag included. Time only moves in hal_idle(), in delays and by a few
+ * cycles per LCD strobe, jumping straight to the next event, so a
+ * simulated hour takes well under a second.
+ *
+ * A harness (firmware_sim.c) provides main(), sets host_inputs and
+ * implements host_update(), host_uart_tx() and host_stop().
+ */
+
+#include <inttypes.h>
+
+typedef struct {
+	uint16_t adc;           // ADC0 result, 0..1023
+	uint16_t distance_cm;   // HC-SR04 target, 0 when nothing echoes
+	uint8_t buttons;        // pressed buttons, bit n is PBn
+	uint8_t reboot;         // level on the reboot switch (INT7)
+} host_inputs_t;
+
+extern host_inputs_t host_inputs;
+
+// The firmware's main(), renamed when main.c is built for the host
+extern int firmware_main(void);
+
+// CPU cycles since reset
+extern uint64_t host_cycles(void);
+
+// Main loop passes since reset (calls to hal_idle())
+extern uint64_t host_loops(void);
+
+// Interrupt handlers run since reset
+extern uint64_t host_interrupts(void);
+
+// Queue bytes for RXD0, they arrive one after the other at the baud rate
+// set in UBRR0 once the receiver is enabled
+extern void host_uart_send(const uint8_t *data, uint16_t len);
+
+// The LCD_DISP_LENGTH characters shown on a row, not terminated. CGRAM
+// characters read as 0..7.
+extern const char *host_lcd_row(uint8_t row);
+
+// Writes the LCD ignored because they came while it was still busy with
+// the previous instruction (LCD_EXEC_US, or LCD_CLEAR_US after a clear)
+extern uint32_t host_lcd_busy_writes(void);
+
+// Implemented by the harness: called whenever simulated time has moved
+// on, before the peripherals look at host_inputs
+extern void host_update(uint64_t cycles);
+
+// Implemented by the harness: a byte left TXD0
+extern void host_uart_tx(uint8_t byte);
+
+// Implemented by the harness: the firmware armed the watchdog to reset
+extern void host_stop(const char *reason) __attribute__((noreturn));
+
+#endif // HAL_HOST_H
@@ -0,0 +1,12 @@
+#ifndef HOST_UTIL_ATOMIC_H
+#define HOST_UTIL_ATOMIC_H
+/*
+ * Host build stand-in for <util/atomic.h>. Interrupts never preempt the
+ * main loop on the host (see avr/interrupt.h), so the block just runs once.
+ */
+
+#define ATOMIC_BLOCK(type)  for (uint8_t host_atomic_ = 1; host_atomic_; host_atomic_ = 0)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#endif // HOST_UTIL_ATOMIC_H
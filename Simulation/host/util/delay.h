@@ -0,0 +1,23 @@
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+/*
+ * Host build stand-in for <util/delay.h>, delays advance simulated time.
+ */
+
+#include <inttypes.h>
+
+#ifndef F_CPU
+#error "F_CPU not defined, include clock.h first"
+#endif
+
+extern void hal_delay_cycles(uint32_t cycles);
+
+static inline void _delay_us(double us) {
+	hal_delay_cycles((uint32_t)(us * (F_CPU / 1000000UL)));
+}
+
+static inline void _delay_ms(double ms) {
+	hal_delay_cycles((uint32_t)(ms * (F_CPU / 1000UL)));
+}
+
+#endif // HOST_UTIL_DELAY_H
@@ -0,0 +1,349 @@
+/*
+ * Checks for the firmware modules that are plain C: fmt, the command
+ * parser, the fan curve, the fan bands, the PID controller, the button
+ * debouncer and the telemetry framing.
+ *
+ * Each check prints where it failed and the run exits non-zero, so
+ * `make check` stops on a regression. The telemetry frames go to a
+ * stand-in for uart_write() and are decoded here like a logger would;
+ * the buttons read PINB from the register array of host/avr/io.h.
+ *
+ * Build and run on the workstation:
+ *   make module_test [VARIANT=Hardware]
+ *   ./module_test
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "fmt.h"
+#include "command.h"
+#include "fancurve.h"
+#include "fanband.h"
+#include "pid.h"
+#include "buttons.h"
+#include "uart.h"
+#include "telemetry.h"
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+volatile host_io_t host_io;
+
+static int checks;
+static int failures;
+
+// Frames handed to uart_write(), and whether it should refuse them
+static uint8_t sent[256];
+static uint8_t sentLen;
+static uint8_t uartFull;
+
+
+static void check(int ok, const char *what, int line) {
+	checks++;
+	if (!ok) {
+		failures++;
+		printf("module_test.c:%d: failed: %s\n", line, what);
+	}
+}
+
+uint8_t uart_write(const uint8_t *buf, uint8_t len) {
+	if (uartFull) {
+		return 0;
+	}
+	memcpy(sent, buf, len);
+	sentLen = len;
+	return 1;
+}
+
+static int field(char *(*fn)(char *, uint8_t, int16_t), uint8_t width, int16_t value, const char *expect) {
+	char buf[8];
+	char *end = fn(buf, width, value);
+
+	return end == buf + width && memcmp(buf, expect, width) == 0;
+}
+
+static char *percent(char *dst, uint8_t width, int16_t value) {
+	return fmt_percent(dst, width, value);
+}
+
+static void test_fmt(void) {
+	CHECK(field(fmt_int, 5, -42, "  -42"));
+	CHECK(field(fmt_int, 5, 0, "    0"));
+	CHECK(field(fmt_int, 6, -32768, "-32768"));
+	CHECK(field(fmt_int, 2, 123, "**"));
+	CHECK(field(fmt_int, 2, -5, "-5"));
+	CHECK(field(fmt_fixed1, 5, 263, " 26.3"));
+	CHECK(field(fmt_fixed1, 4, -5, "-0.5"));
+	CHECK(field(fmt_fixed1, 3, 1000, "***"));
+	CHECK(field(percent, 4, 50, " 50%"));
+	CHECK(field(percent, 4, 100, "100%"));
+	CHECK(field(percent, 3, 100, "***"));
+}
+
+// Feed a string, returns the result of its last byte
+static uint8_t feed(const char *s, command_t *cmd) {
+	uint8_t result = COMMAND_NONE;
+
+	while (*s) {
+		result = command_feed(*s++, cmd);
+	}
+	return result;
+}
+
+static void test_command(void) {
+	command_t cmd;
+
+	CHECK(feed("o 120\n", &cmd) == COMMAND_READY);
+	CHECK(cmd.name == 'o' && cmd.argc == 1 && cmd.argv[0] == 120);
+
+	CHECK(feed("\r\n  C 2,-350, 180\r", &cmd) == COMMAND_READY);
+	CHECK(cmd.name == 'c' && cmd.argc == 3);
+	CHECK(cmd.argv[0] == 2 && cmd.argv[1] == -350 && cmd.argv[2] == 180);
+
+	CHECK(feed("s\n", &cmd) == COMMAND_READY);
+	CHECK(cmd.name == 's' && cmd.argc == 0);
+
+	CHECK(feed("f 32767\n", &cmd) == COMMAND_READY && cmd.argv[0] == 32767);
+	CHECK(feed("f 32768\n", &cmd) == COMMAND_ERROR);
+	CHECK(feed("f -\n", &cmd) == COMMAND_ERROR);
+	CHECK(feed("b 1 2 3 4 5\n", &cmd) == COMMAND_ERROR);
+	CHECK(feed("1 2\n", &cmd) == COMMAND_ERROR);
+	CHECK(feed("o 1x\n", &cmd) == COMMAND_ERROR);
+
+	// Nothing is reported before the end of the line, and a bad line does
+	// not spoil the next one
+	CHECK(feed("o 5", &cmd) == COMMAND_NONE);
+	CHECK(feed("\nl -1\n", &cmd) == COMMAND_READY);
+	CHECK(cmd.name == 'l' && cmd.argc == 1 && cmd.argv[0] == -1);
+}
+
+static void test_fancurve(void) {
+	static const fan_point_t curve[] PROGMEM = {
+		{ 240,   0 },
+		{ 300, 100 },
+		{ 400, 200 },
+		{ 500, 255 }
+	};
+	uint8_t duty;
+
+	CHECK(fan_curve_init(curve, 4) == 0); // EEPROM empty on the host
+	CHECK(fan_curve_lookup(100, &duty) && duty == 0);
+	CHECK(fan_curve_lookup(300, &duty) && duty == 100);
+	CHECK(fan_curve_lookup(350, &duty) && duty == 150);
+	CHECK(fan_curve_lookup(500, &duty) && duty == 255);
+	CHECK(!fan_curve_lookup(501, &duty) && duty == 0);
+
+	CHECK(!fan_curve_set(1, 240, 50));   // not above point 0
+	CHECK(!fan_curve_set(1, 400, 50));   // not below point 2
+	CHECK(!fan_curve_set(5, 600, 50));   // past the end
+	CHECK(fan_curve_set(1, 250, 50));
+	CHECK(fan_curve_lookup(250, &duty) && duty == 50);
+	CHECK(fan_curve_set(4, 600, 255));   // added after the last
+	CHECK(fan_curve_lookup(550, &duty) && duty == 255);
+}
+
+static void test_fanband(void) {
+	static const fan_band_t bands[] PROGMEM = {
+		{ 240, 5,   0 },
+		{ 300, 5, 100 },
+		{ 350, 5, 155 },
+		{   0, 0, 255 }
+	};
+	uint32_t now = 0; // ms, handed over as the 16-bit scheduler_millis()
+	uint8_t chatter = 0;
+
+	fan_band_init(bands, 4, 5000);
+	CHECK(fan_band_update(200, now) == 0);
+	CHECK(fan_band_update(241, now += 100) == 100); // the first change is not held
+	CHECK(fan_band_current() == 1 && fan_band_transitions() == 1);
+
+	// Hovering around the edge stays inside the hysteresis, long past the dwell
+	for (int i = 0; i < 200; i++) {
+		chatter |= fan_band_update((i & 1) ? 244 : 236, now += 100) != 100;
+	}
+	CHECK(!chatter && fan_band_transitions() == 1);
+
+	// Down below the hysteresis, then up again too soon
+	CHECK(fan_band_update(234, now += 100) == 0);
+	CHECK(fan_band_update(310, now += 1000) == 0);
+	CHECK(fan_band_update(310, now += 3999) == 0);
+	CHECK(fan_band_update(310, now += 1) == 155);   // two bands in one step
+	CHECK(fan_band_transitions() == 3);
+
+	// The hourly count only covers complete hours, the clock keeps them
+	// going without readings
+	CHECK(fan_band_transitions_per_hour() == 0);
+	while (now < 3600000UL) {
+		fan_band_clock((uint16_t)(now += 30000));
+	}
+	CHECK(fan_band_transitions_per_hour() == 3);
+	CHECK(fan_band_update(310, now += 100) == 155 && fan_band_transitions() == 3);
+
+	CHECK(!fan_band_set(1, 240, 5, 90));  // not above band 0
+	CHECK(!fan_band_set(1, 350, 5, 90));  // not below band 2
+	CHECK(!fan_band_set(4, 400, 5, 90));  // past the end
+	CHECK(fan_band_set(3, 0, 0, 200));    // top of the last band is not used
+	CHECK(fan_band_set(1, 260, 5, 90));
+	CHECK(fan_band_update(250, now += 100) == 90);
+}
+
+static void test_pid(void) {
+	pid_ctrl_t pid;
+	uint8_t duty = 0;
+
+	pid_init(&pid, 1280, 26, 0, 260, 0, 255);
+	CHECK(pid_update(&pid, 250) == 0);   // below the setpoint, reverse acting
+	CHECK(pid_update(&pid, 265) > 0);
+	for (int i = 0; i < 100; i++) {
+		duty = pid_update(&pid, 400);
+	}
+	CHECK(duty == 255);
+
+	// Anti-windup: back below the setpoint the fan lets go at once
+	CHECK(pid_update(&pid, 250) < 128);
+
+	pid_reset(&pid);
+	CHECK(pid.integral == 0 && !pid.primed);
+}
+
+// Hold PINB at 'pins' for 'samples' debounce samples of the tick hook
+static void sample_buttons(uint8_t pins, uint16_t samples) {
+	PINB = pins;
+	for (uint16_t i = 0; i < samples * BUTTON_SAMPLE_MS; i++) {
+		buttons_tick();
+	}
+}
+
+static void test_buttons(void) {
+	uint8_t bounced = 0;
+
+	buttons_init();
+	sample_buttons(0xFF, 8); // nothing pressed, the buttons pull low
+
+	// Contact bounce shorter than four samples is ignored, then the press
+	// comes out as a single event
+	for (int i = 0; i < 6; i++) {
+		sample_buttons(0xFE, 1);
+		sample_buttons(0xFF, 1);
+		bounced |= buttons_event() != BUTTON_NONE;
+	}
+	CHECK(!bounced && buttons_state() == 0);
+	sample_buttons(0xFE, 4);
+	CHECK(buttons_state() == 0x01);
+	CHECK(buttons_event() == (BUTTON_PRESS | 0));
+	CHECK(buttons_event() == BUTTON_NONE);
+
+	// One long press after BUTTON_LONG_MS, however long the button is held
+	sample_buttons(0xFE, BUTTON_LONG_MS / BUTTON_SAMPLE_MS - 1);
+	CHECK(buttons_event() == BUTTON_NONE);
+	sample_buttons(0xFE, 1);
+	CHECK(buttons_event() == (BUTTON_LONG | 0));
+	sample_buttons(0xFE, 2 * BUTTON_LONG_MS / BUTTON_SAMPLE_MS);
+	CHECK(buttons_event() == BUTTON_NONE);
+
+	sample_buttons(0xFF, 1);
+	sample_buttons(0xFE, 1);
+	sample_buttons(0xFF, 4);
+	CHECK(buttons_event() == (BUTTON_RELEASE | 0));
+	CHECK(buttons_event() == BUTTON_NONE && buttons_state() == 0);
+
+	// The ring holds BUTTON_QUEUE_SIZE - 1 events, the rest are counted
+	for (int i = 0; i < BUTTON_QUEUE_SIZE; i++) {
+		sample_buttons(0xF7, 4);
+		sample_buttons(0xFF, 4);
+	}
+	CHECK(buttons_overflows() == BUTTON_QUEUE_SIZE + 1);
+	CHECK(buttons_event() == (BUTTON_PRESS | 3));
+	CHECK(buttons_event() == (BUTTON_RELEASE | 3));
+	for (int i = 2; i < BUTTON_QUEUE_SIZE - 1; i++) {
+		buttons_event();
+	}
+	CHECK(buttons_event() == BUTTON_NONE);
+}
+
+static uint8_t crc8(const uint8_t *data, size_t len) {
+	uint8_t crc = 0;
+
+	while (len--) {
+		crc ^= *data++;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+// Undo COBS, returns the decoded length or 0 when malformed
+static size_t cobs_decode(const uint8_t *in, size_t len, uint8_t *out) {
+	size_t i = 0, n = 0;
+
+	while (i < len) {
+		uint8_t code = in[i++];
+
+		if (code == 0 || i + code - 1 > len) {
+			return 0;
+		}
+		for (uint8_t k = 1; k < code; k++) {
+			out[n++] = in[i++];
+		}
+		if (i < len) {
+			out[n++] = 0;
+		}
+	}
+	return n;
+}
+
+// Decode the last frame sent and check its shape, CRC and contents
+static int frame_is(uint8_t type, const uint8_t *payload, uint8_t len, uint8_t *seq) {
+	uint8_t raw[256];
+	size_t n;
+
+	if (sentLen < 2 || sent[sentLen - 1] != 0 || memchr(sent, 0, sentLen - 1) != NULL) {
+		return 0;
+	}
+	n = cobs_decode(sent, sentLen - 1, raw);
+	*seq = raw[0];
+	return n == len + 3u && raw[1] == type && memcmp(&raw[2], payload, len) == 0
+	    && crc8(raw, n - 1) == raw[n - 1];
+}
+
+static void test_telemetry(void) {
+	uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+	uint8_t seq, first;
+
+	CHECK(crc8((const uint8_t *)"123456789", 9) == 0xF4); // CRC-8 check value
+
+	memset(payload, 0, sizeof(payload));
+	CHECK(telemetry_send(TELEMETRY_STATUS, payload, 4));
+	CHECK(frame_is(TELEMETRY_STATUS, payload, 4, &first));
+
+	for (uint8_t i = 0; i < sizeof(payload); i++) {
+		payload[i] = i * 37; // zeros and non-zeros mixed
+	}
+	CHECK(telemetry_send(TELEMETRY_REPLY, payload, sizeof(payload)));
+	CHECK(frame_is(TELEMETRY_REPLY, payload, sizeof(payload), &seq) && seq == (uint8_t)(first + 1));
+
+	// Refused frames are counted and still use up a sequence number
+	uartFull = 1;
+	CHECK(!telemetry_send(TELEMETRY_STATUS, payload, 1));
+	CHECK(telemetry_drops() == 1);
+	uartFull = 0;
+	CHECK(telemetry_send(TELEMETRY_STATUS, payload, 0));
+	CHECK(frame_is(TELEMETRY_STATUS, payload, 0, &seq) && seq == (uint8_t)(first + 3));
+}
+
+int main(void) {
+	test_fmt();
+	test_command();
+	test_fancurve();
+	test_fanband();
+	test_pid();
+	test_buttons();
+	test_telemetry();
+
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures != 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Host-side simulation of the fan controller.
+ *
+ * Runs the firmware's pid.c against a first-order thermal model of the
+ * room and compares it with the old five-band logic of temperatureCondition().
+ * Use it to tune the gains before flashing.
+ *
+ * Build and run on the workstation:
+ *   gcc -O2 -I"../Software/C program" pid_sim.c "../Software/C program/pid.c" -lm -o pid_sim
+ *   ./pid_sim [kp ki kd [setpoint]]
+ *
+ * Gains are the Q8 values passed to pid_init(), the setpoint is in tenths
+ * of a degree C. The defaults match PID_KP, PID_KI, PID_KD and
+ * PID_SETPOINT in main.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "pid.h"
+
+// Room model: C dT/dt = load - (h0 + hFan * duty / 255) * (T - outside)
+#define SIM_STEP_S       0.1     // integration step
+#define SIM_LENGTH_S     7200.0  // simulated time
+#define SIM_CONTROL_S    1.0     // controller period, PID_PERIOD_MS in main.c
+#define SIM_CAPACITY     600.0   // J/K, sets the time constant of the room
+#define SIM_H0           1.0     // W/K lost without the fan
+#define SIM_HFAN         4.0     // W/K extra at full duty
+#define SIM_OUTSIDE      20.0    // C
+#define SIM_LOAD         20.0    // W, settles at 40 C with the fan off
+#define SIM_START        40.0    // C
+#define SIM_BAND         0.5     // C, settling band around the setpoint
+#define SIM_NOISE        0.1     // C, peak sensor noise
+#define SIM_ADC_STEP     (500.0 / 8192)  // C per count of the 13-bit reading
+
+typedef struct {
+	double settling;     // s until the temperature stays within the band, <0 if never
+	double overshoot;    // C below the setpoint after the first crossing
+	double ripple;       // C peak to peak over the last quarter of the run
+	double final;        // C at the end of the run
+	double energy;       // duty-weighted hours at full speed
+	unsigned changes;    // number of duty changes
+} sim_result_t;
+
+typedef uint8_t (*controller_fn)(int16_t temp, void *ctx);
+
+
+// The old band ladder of the Software project, in tenths of a degree
+static uint8_t band_controller(int16_t temp, void *ctx) {
+	(void)ctx;
+	if (temp <= 240) {
+		return 0;
+	} else if (temp <= 300) {
+		return 100;
+	} else if (temp <= 350) {
+		return 155;
+	} else if (temp <= 400) {
+		return 200;
+	} else if (temp >= 410 && temp <= 500) {
+		return 255;
+	}
+	return 0;
+}
+
+static uint8_t pid_controller(int16_t temp, void *ctx) {
+	return pid_update((pid_ctrl_t *)ctx, temp);
+}
+
+static int16_t sensor(double temp) {
+	double noisy = temp + SIM_NOISE * (2.0 * rand() / RAND_MAX - 1.0);
+	long counts = lround(noisy / SIM_ADC_STEP);
+
+	return (int16_t)((counts * 625) >> 10);   // LM35_DECI_C() for 13 bits
+}
+
+static sim_result_t simulate(controller_fn controller, void *ctx, double setpoint) {
+	sim_result_t r = { -1.0, 0.0, 0.0, 0.0, 0.0, 0 };
+	double temp = SIM_START;
+	double nextControl = 0.0;
+	double lo = 1e9, hi = -1e9;
+	uint8_t duty = 0;
+	int crossed = 0;
+
+	srand(1);
+	for (double t = 0.0; t < SIM_LENGTH_S; t += SIM_STEP_S) {
+		if (t >= nextControl) {
+			uint8_t next = controller(sensor(temp), ctx);
+			if (next != duty) {
+				r.changes++;
+			}
+			duty = next;
+			nextControl += SIM_CONTROL_S;
+		}
+
+		double h = SIM_H0 + SIM_HFAN * duty / 255.0;
+		temp += (SIM_LOAD - h * (temp - SIM_OUTSIDE)) * SIM_STEP_S / SIM_CAPACITY;
+		r.energy += duty / 255.0 * SIM_STEP_S / 3600.0;
+
+		if (fabs(temp - setpoint) > SIM_BAND) {
+			r.settling = -1.0;
+		} else if (r.settling < 0) {
+			r.settling = t;
+		}
+		if (temp <= setpoint) {
+			crossed = 1;
+		}
+		if (crossed && setpoint - temp > r.overshoot) {
+			r.overshoot = setpoint - temp;
+		}
+		if (t >= SIM_LENGTH_S * 0.75) {
+			lo = temp < lo ? temp : lo;
+			hi = temp > hi ? temp : hi;
+		}
+	}
+	r.ripple = hi - lo;
+	r.final = temp;
+	return r;
+}
+
+static void report(const char *name, sim_result_t r) {
+	char settling[16];
+
+	if (r.settling < 0) {
+		snprintf(settling, sizeof(settling), "never");
+	} else {
+		snprintf(settling, sizeof(settling), "%.0f s", r.settling);
+	}
+	printf("%-6s settling %-8s overshoot %5.2f C  final %5.2f C  ripple %5.2f C  energy %5.2f h  duty changes %u\n",
+	       name, settling, r.overshoot, r.final, r.ripple, r.energy, r.changes);
+}
+
+int main(int argc, char **argv) {
+	int16_t kp = argc > 1 ? atoi(argv[1]) : 1280;
+	int16_t ki = argc > 2 ? atoi(argv[2]) : 26;
+	int16_t kd = argc > 3 ? atoi(argv[3]) : 0;
+	int16_t setpoint = argc > 4 ? atoi(argv[4]) : 260;
+	pid_ctrl_t pid;
+
+	pid_init(&pid, kp, ki, kd, setpoint, 0, 255);
+
+	printf("room %.0f C -> setpoint %.1f C, kp %d ki %d kd %d (Q8)\n", SIM_START, setpoint / 10.0, kp, ki, kd);
+	report("bands", simulate(band_controller, NULL, setpoint / 10.0));
+	report("pid", simulate(pid_controller, &pid, setpoint / 10.0));
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * SRAM used by each module, from the linker map of a firmware build.
+ *
+ * Reads "C program.map" (written by the Debug build with -Wl,-Map) and
+ * adds up the .data and .bss input sections kept in the image, per
+ * object file. .rodata counts as .data because avr-gcc copies it into
+ * SRAM at startup like any initialised variable. The rest of the 4 KB is
+ * left to the stack, see stack.h for its high-water mark at runtime.
+ *
+ * Build and run on the workstation:
+ *   make ram [VARIANT=Hardware]
+ *   ./ramsize "../Software/C program/Debug/C program.map"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAM_SIZE     4096    // ATmega64 SRAM
+#define MAX_MODULES  64
+
+typedef struct {
+	char name[64];
+	unsigned long data;
+	unsigned long bss;
+} module_t;
+
+static module_t modules[MAX_MODULES];
+static int moduleCount;
+
+
+// Object file name without its directory, archives keep their member
+static const char *module_name(const char *path) {
+	const char *paren = strchr(path, '(');
+	const char *slash = NULL;
+
+	for (const char *p = path; *p && (paren == NULL || p < paren); p++) {
+		if (*p == '/' || *p == '\\') {
+			slash = p;
+		}
+	}
+	return slash ? slash + 1 : path;
+}
+
+static module_t *module(const char *path) {
+	char name[64];
+
+	snprintf(name, sizeof(name), "%.63s", module_name(path));
+	name[strcspn(name, "\r\n")] = '\0';
+	for (int i = 0; i < moduleCount; i++) {
+		if (strcmp(modules[i].name, name) == 0) {
+			return &modules[i];
+		}
+	}
+	if (moduleCount == MAX_MODULES) {
+		return &modules[MAX_MODULES - 1]; // lump the rest into the last entry
+	}
+	snprintf(modules[moduleCount].name, sizeof(modules[0].name), "%s", name);
+	return &modules[moduleCount++];
+}
+
+// 1 for .data, 2 for .bss, 0 for any other section
+static int kind(const char *section) {
+	if (!strncmp(section, ".data", 5) || !strncmp(section, ".rodata", 7)) {
+		return 1;
+	}
+	if (!strncmp(section, ".bss", 4) || !strncmp(section, ".noinit", 7)) {
+		return 2;
+	}
+	return 0;
+}
+
+static int by_size(const void *a, const void *b) {
+	const module_t *ma = a, *mb = b;
+	unsigned long sa = ma->data + ma->bss, sb = mb->data + mb->bss;
+
+	return (sa < sb) - (sa > sb);
+}
+
+int main(int argc, char **argv) {
+	FILE *f;
+	char line[512];
+	char pending[128] = "";     // section name whose address is on the next line
+	int inMap = 0;
+	unsigned long data = 0, bss = 0;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s \"C program.map\"\n", argv[0]);
+		return 2;
+	}
+	if ((f = fopen(argv[1], "r")) == NULL) {
+		perror(argv[1]);
+		return 2;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		char section[128], path[384];
+		unsigned long addr, size;
+
+		// Sections listed before this line were discarded by --gc-sections
+		if (!inMap) {
+			inMap = strncmp(line, "Linker script and memory map", 28) == 0;
+			continue;
+		}
+
+		// Input sections: " .bss.name  0xaddr  0xsize  file.o", the name on a
+		// line of its own when it is too long
+		if (line[0] == ' ' && line[1] == '.') {
+			char more[2];
+
+			if (sscanf(line, " %127s 0x%lx 0x%lx %383[^\n]", section, &addr, &size, path) != 4) {
+				// Keep the name if it is alone on the line
+				if (sscanf(line, " %127s %1s", pending, more) != 1) {
+					pending[0] = '\0';
+				}
+				continue;
+			}
+			pending[0] = '\0';
+		} else if (pending[0] && sscanf(line, " 0x%lx 0x%lx %383[^\n]", &addr, &size, path) == 3) {
+			snprintf(section, sizeof(section), "%s", pending);
+			pending[0] = '\0';
+		} else {
+			pending[0] = '\0';
+			continue;
+		}
+
+		int k = kind(section);
+		if (k == 0 || size == 0) {
+			continue;
+		}
+		module_t *m = module(path);
+		if (k == 1) {
+			m->data += size;
+			data += size;
+		} else {
+			m->bss += size;
+			bss += size;
+		}
+	}
+	fclose(f);
+
+	if (!inMap) {
+		fprintf(stderr, "%s: no memory map, is this a linker map file?\n", argv[1]);
+		return 2;
+	}
+
+	qsort(modules, moduleCount, sizeof(modules[0]), by_size);
+	printf("%-24s %6s %6s %6s\n", "module", ".data", ".bss", "total");
+	for (int i = 0; i < moduleCount; i++) {
+		printf("%-24s %6lu %6lu %6lu\n", modules[i].name, modules[i].data, modules[i].bss, modules[i].data + modules[i].bss);
+	}
+	printf("%-24s %6lu %6lu %6lu  %lu%% of %u, %lu left for the stack\n", "total", data, bss, data + bss,
+	       (data + bss) * 100 / RAM_SIZE, RAM_SIZE, data + bss < RAM_SIZE ? RAM_SIZE - data - bss : 0);
+	return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef ADC_H
+#define ADC_H
+/*
+ * Free-running, interrupt-driven ADC for the LM35 on ADC0/PF0.
+ *
+ * The ADC converts continuously. Every conversion is added to an
+ * oversampling accumulator; after 4^ADC_OVERSAMPLE_BITS conversions the
+ * sum is decimated to a (10 + ADC_OVERSAMPLE_BITS)-bit sample and pushed
+ * into a ring buffer. The moving average over the ring is cached, so
+ * adc_value() returns immediately without waiting for a conversion.
+ */
+
+#include <inttypes.h>
+
+#include "clock.h"
+
+#define ADC_CHANNEL          0     // LM35 on ADC0/PF0
+#define ADC_OVERSAMPLE_BITS  3     // 1: 4x, 2: 16x, 3: 64x oversampling
+#define ADC_RING_SIZE        8     // decimated samples in the moving average, power of two
+
+#define ADC_OVERSAMPLE       (1 << (2 * ADC_OVERSAMPLE_BITS))
+#define ADC_RESULT_BITS      (10 + ADC_OVERSAMPLE_BITS)
+#define ADC_FULL_SCALE       (1UL << ADC_RESULT_BITS)   // value equal to AVcc
+
+#if ADC_OVERSAMPLE_BITS > 3
+#error "ADC accumulator is 16 bits, at most 64x oversampling"
+#endif
+#if (ADC_RING_SIZE & (ADC_RING_SIZE - 1)) || (ADC_RING_SIZE << ADC_RESULT_BITS) > 0x10000UL
+#error "ADC_RING_SIZE must be a power of two and the ring sum must fit in 16 bits"
+#endif
+
+// LM35 reading in tenths of a degree C. The LM35 has a sensitivity of
+// 10 mV/C and the reference is 5 V (AVcc), so full scale is 500.0 C and
+// one count is 5000 / 2^bits = 625 / 2^(bits - 3) tenths.
+#define LM35_DECI_C(adc)  ((int16_t)(((uint32_t)(adc) * 625) >> (ADC_RESULT_BITS - 3)))
+
+// Start free-running conversions. Call before sei().
+extern void adc_init(void);
+
+// Latest filtered reading, 0 .. ADC_FULL_SCALE - 1
+extern uint16_t adc_value(void);
+
+// Non-zero once the ring buffer has been filled
+extern uint8_t adc_ready(void);
+
+#endif // ADC_H
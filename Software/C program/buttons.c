@@ -0,0 +1,87 @@
+#include <avr/io.h>
+
+#include "buttons.h"
+
+#define LONG_SAMPLES  (BUTTON_LONG_MS / BUTTON_SAMPLE_MS)
+
+#if LONG_SAMPLES > 255
+#error "BUTTON_LONG_MS too long for an 8-bit hold counter"
+#endif
+
+static uint8_t divider = 0;
+static uint8_t ct0 = 0xFF, ct1 = 0xFF;       // vertical 2-bit counters, one bit per button
+static volatile uint8_t state = 0;           // debounced pressed buttons
+static uint8_t held[BUTTON_COUNT];           // samples each button has been held
+static volatile uint8_t overflows = 0;
+
+// Single producer (tick ISR) writes head, single consumer (main loop) writes tail
+static uint8_t queue[BUTTON_QUEUE_SIZE];
+static volatile uint8_t head = 0;
+static volatile uint8_t tail = 0;
+
+
+static void push(uint8_t event) {
+	uint8_t next = (head + 1) & (BUTTON_QUEUE_SIZE - 1);
+
+	if (next == tail) {
+		overflows++;
+		return;
+	}
+	queue[head] = event;
+	head = next;
+}
+
+void buttons_init(void) {
+	DDRB &= ~BUTTON_MASK; // Buttons as inputs with pull-ups
+	PORTB |= BUTTON_MASK;
+}
+
+void buttons_tick(void) {
+	if (++divider < BUTTON_SAMPLE_MS) {
+		return;
+	}
+	divider = 0;
+
+	// Count every button whose raw level differs from its debounced state,
+	// reset the count of the others; flip the state when the count wraps
+	uint8_t changed = (state ^ ~PINB) & BUTTON_MASK;
+	ct0 = ~(ct0 & changed);
+	ct1 = ct0 ^ (ct1 & changed);
+	changed &= ct0 & ct1;
+	state ^= changed;
+
+	uint8_t pressed = state;
+	if (!(changed | pressed)) {
+		return; // idle, nothing to queue or time
+	}
+	for (uint8_t n = 0; n < BUTTON_COUNT; n++) {
+		uint8_t bit = 1 << n;
+
+		if (changed & bit) {
+			push(((pressed & bit) ? BUTTON_PRESS : BUTTON_RELEASE) | n);
+			held[n] = 0;
+		} else if ((pressed & bit) && held[n] < LONG_SAMPLES && ++held[n] == LONG_SAMPLES) {
+			push(BUTTON_LONG | n);
+		}
+	}
+}
+
+uint8_t buttons_event(void) {
+	uint8_t t = tail;
+
+	if (t == head) {
+		return BUTTON_NONE;
+	}
+	uint8_t event = queue[t];
+	tail = (t + 1) & (BUTTON_QUEUE_SIZE - 1);
+
+	return event;
+}
+
+uint8_t buttons_state(void) {
+	return state;
+}
+
+uint8_t buttons_overflows(void) {
+	return overflows;
+}
@@ -0,0 +1,45 @@
+#ifndef BUTTONS_H
+#define BUTTONS_H
+/*
+ * Debounced push buttons on PB0..PB3 (active low, internal pull-ups).
+ *
+ * buttons_tick() runs from the 1 ms scheduler tick and samples the port
+ * every BUTTON_SAMPLE_MS through a 2-bit vertical counter, so a button
+ * has to be stable for four samples before its state flips. Changes are
+ * queued as press, release and long-press events in a single-producer,
+ * single-consumer ring that the main loop drains with buttons_event().
+ */
+
+#include <inttypes.h>
+
+#define BUTTON_MASK        0x0F   // PB0..PB3
+#define BUTTON_COUNT       4
+#define BUTTON_SAMPLE_MS   4      // debounce time is four samples
+#define BUTTON_LONG_MS     1000   // held this long for a long press
+#define BUTTON_QUEUE_SIZE  16     // power of two
+
+// Event encoding: type in the upper nibble, button number 0..3 in the lower
+#define BUTTON_PRESS    0x10
+#define BUTTON_RELEASE  0x20
+#define BUTTON_LONG     0x30
+#define BUTTON_NONE     0x00
+
+#define BUTTON_EVENT_TYPE(e)    ((e) & 0xF0)
+#define BUTTON_EVENT_NUMBER(e)  ((e) & 0x0F)
+
+// Set up the pins. Register buttons_tick() as a scheduler tick hook.
+extern void buttons_init(void);
+
+// Sampler, called from the tick interrupt every millisecond
+extern void buttons_tick(void);
+
+// Next queued event, or BUTTON_NONE when the queue is empty
+extern uint8_t buttons_event(void);
+
+// Debounced state, bit n set while button n is held down
+extern uint8_t buttons_state(void);
+
+// Events lost because the queue was full
+extern uint8_t buttons_overflows(void);
+
+#endif // BUTTONS_H
@@ -0,0 +1,76 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+/*
+ * CPU clock and everything derived from it.
+ *
+ * F_CPU is set here and nowhere else, and every module includes this
+ * header before anything that looks at the clock (util/delay.h included).
+ * Delay loop counts, timer and ADC prescalers and UART divisors follow
+ * from F_CPU at compile time and are range checked, so moving the board
+ * between the internal 1 MHz oscillator and an 8 or 16 MHz crystal is a
+ * one-line change (plus the fuses).
+ */
+
+#include <inttypes.h>
+
+#ifndef F_CPU
+#define F_CPU 1000000UL     // internal RC oscillator, 8000000UL or 16000000UL with a crystal
+#endif
+
+_Static_assert(F_CPU == 1000000UL || F_CPU == 8000000UL || F_CPU == 16000000UL,
+               "F_CPU must be 1, 8 or 16 MHz");
+
+#define CLOCK_CYCLES_PER_US  (F_CPU / 1000000UL)
+
+// Iterations of a 4-cycle busy loop that last at least 'us' microseconds
+#define CLOCK_LOOPS4(us)     (((uint32_t)(us) * CLOCK_CYCLES_PER_US + 3) / 4)
+
+// Longest delay a 16-bit 4-cycle loop counter can make
+#define CLOCK_LOOPS4_MAX_US  (0xFFFFUL * 4 / CLOCK_CYCLES_PER_US)
+
+// Timer0/Timer2 fan PWM. The L293D switches slowly, so keep the PWM
+// frequency at a few kHz: F_CPU / 256 / prescaler.
+#if F_CPU <= 2000000UL
+#define CLOCK_PWM_PRESCALE   1
+#else
+#define CLOCK_PWM_PRESCALE   8      // available on both Timer0 and Timer2
+#endif
+#define CLOCK_PWM_HZ         (F_CPU / 256 / CLOCK_PWM_PRESCALE)
+_Static_assert(CLOCK_PWM_HZ >= 1000 && CLOCK_PWM_HZ <= 10000, "fan PWM outside 1..10 kHz");
+
+// Timer3 echo timestamps, one or two counts per microsecond
+#if F_CPU <= 2000000UL
+#define CLOCK_TIMESTAMP_PRESCALE  1
+#else
+#define CLOCK_TIMESTAMP_PRESCALE  8
+#endif
+#define CLOCK_TIMESTAMP_PER_US    (F_CPU / CLOCK_TIMESTAMP_PRESCALE / 1000000UL)
+_Static_assert(CLOCK_TIMESTAMP_PER_US >= 1 && CLOCK_TIMESTAMP_PER_US <= 2,
+               "Timer3 must count 1 or 2 per microsecond");
+
+// ADC clock. 128 is the largest prescaler; it keeps the free-running
+// conversion interrupt rare enough for a 1 MHz CPU (600/s) and the ADC
+// clock inside the 200 kHz limit for full 10-bit accuracy at 16 MHz.
+#define CLOCK_ADC_PRESCALE   128
+#define CLOCK_ADC_ADPS       7      // ADPS2..0 for CLOCK_ADC_PRESCALE
+#define CLOCK_ADC_HZ         (F_CPU / CLOCK_ADC_PRESCALE)
+_Static_assert((1 << CLOCK_ADC_ADPS) == CLOCK_ADC_PRESCALE, "ADPS bits do not match the prescaler");
+_Static_assert(CLOCK_ADC_HZ <= 200000UL, "ADC clock above 200 kHz");
+
+// HD44780 clear display and return home at the slowest controller
+// oscillator (190 kHz), 1.52 ms at the nominal 270 kHz. Both the timed LCD
+// mode and the async queue wait for this.
+#define CLOCK_LCD_CLEAR_US   2160
+
+// USART in double speed mode (U2X): baud = F_CPU / (8 * (UBRR + 1))
+#define CLOCK_UART_BAUD      9600
+#define CLOCK_UBRR(baud)     ((F_CPU + 4UL * (baud)) / (8UL * (baud)) - 1)
+#define CLOCK_UART_ACTUAL(baud)  (F_CPU / (8UL * (CLOCK_UBRR(baud) + 1)))
+// Baud rate error in tenths of a percent, absolute
+#define CLOCK_UART_ERROR(baud)   (CLOCK_UART_ACTUAL(baud) > (baud) \
+	? (CLOCK_UART_ACTUAL(baud) - (baud)) * 1000UL / (baud) \
+	: ((baud) - CLOCK_UART_ACTUAL(baud)) * 1000UL / (baud))
+_Static_assert(CLOCK_UBRR(CLOCK_UART_BAUD) <= 0x0FFF, "UBRR out of range for CLOCK_UART_BAUD");
+_Static_assert(CLOCK_UART_ERROR(CLOCK_UART_BAUD) <= 20, "CLOCK_UART_BAUD more than 2% off at this F_CPU");
+
+#endif // CLOCK_H
@@ -0,0 +1,57 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "fan.h"
+
+#define STEP  ((uint16_t)FAN_RAMP_STEP_Q8)
+
+static volatile uint8_t target = 0;
+static uint16_t position = 0;   // Q8 duty, only touched by the ISR after fan_init()
+
+
+ISR(TIMER0_OVF_vect) {
+	uint16_t goal = (uint16_t)target << 8;
+
+	if (position < goal) {
+		position = ((uint16_t)(goal - position) > STEP) ? position + STEP : goal;
+	} else if (position > goal) {
+		position = ((uint16_t)(position - goal) > STEP) ? position - STEP : goal;
+	}
+
+	OCR0 = position >> 8;
+	OCR2 = position >> 8;
+
+	if (position == goal) {
+		TIMSK &= ~(1 << TOIE0); // Ramp finished, nothing to do until the next target
+	}
+}
+
+void fan_init(void) {
+	// Timer0 and Timer2 in fast PWM mode, non-inverting output, CLOCK_PWM_PRESCALE
+	OCR0 = 0;
+	OCR2 = 0;
+#if CLOCK_PWM_PRESCALE == 1
+	TCCR0 = (1 << WGM00) | (1 << COM01) | (1 << WGM01) | (1 << CS00);
+	TCCR2 = (1 << WGM20) | (1 << COM21) | (1 << WGM21) | (1 << CS20);
+#else
+	TCCR0 = (1 << WGM00) | (1 << COM01) | (1 << WGM01) | (1 << CS01);
+	TCCR2 = (1 << WGM20) | (1 << COM21) | (1 << WGM21) | (1 << CS21);
+#endif
+	position = 0;
+	target = 0;
+}
+
+void fan_set_target(uint8_t duty) {
+	if (duty != target) {
+		target = duty;
+		TIMSK |= (1 << TOIE0);
+	}
+}
+
+uint8_t fan_target(void) {
+	return target;
+}
+
+uint8_t fan_duty(void) {
+	return OCR0;
+}
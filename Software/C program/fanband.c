@@ -0,0 +1,97 @@
+#include <avr/pgmspace.h>
+
+#include "fanband.h"
+
+#define HOUR_MS  3600000UL
+
+static fan_band_t bands[FAN_BAND_MAX];
+static uint8_t bandCount = 0;
+static uint8_t current = 0;
+static uint16_t dwell = 0;
+
+static uint16_t lastNow = 0;
+static uint32_t elapsed = 0;        // ms since fan_band_init()
+static uint32_t lastChange = 0;     // elapsed at the last band change
+static uint32_t hourStart = 0;      // elapsed at the start of the current hour
+static uint16_t transitions = 0;
+static uint16_t hourTransitions = 0;
+static uint16_t lastHourTransitions = 0;
+
+
+void fan_band_init(const fan_band_t *table, uint8_t count, uint16_t dwell_ms) {
+	if (count > FAN_BAND_MAX) {
+		count = FAN_BAND_MAX;
+	}
+	memcpy_P(bands, table, count * sizeof(fan_band_t));
+	bandCount = count;
+	current = 0;
+	dwell = dwell_ms;
+	elapsed = 0;
+	lastChange = 0;
+	hourStart = 0;
+	transitions = 0;
+	hourTransitions = 0;
+	lastHourTransitions = 0;
+}
+
+void fan_band_clock(uint16_t now) {
+	// Extend the 16-bit millisecond clock so dwell and hour spans can be long
+	elapsed += (uint16_t)(now - lastNow);
+	lastNow = now;
+
+	if (elapsed - hourStart >= HOUR_MS) {
+		lastHourTransitions = hourTransitions;
+		hourTransitions = 0;
+		hourStart = elapsed;
+	}
+}
+
+uint8_t fan_band_update(int16_t temp, uint16_t now) {
+	fan_band_clock(now);
+
+	uint8_t target = current;
+	while (target + 1 < bandCount && temp > bands[target].upper) {
+		target++;
+	}
+	while (target > 0 && temp < bands[target - 1].upper - bands[target - 1].hysteresis) {
+		target--;
+	}
+
+	if (target != current && (transitions == 0 || elapsed - lastChange >= dwell)) {
+		current = target;
+		lastChange = elapsed;
+		transitions++;
+		hourTransitions++;
+	}
+
+	return bands[current].duty;
+}
+
+uint8_t fan_band_set(uint8_t index, int16_t upper, uint8_t hysteresis, uint8_t duty) {
+	if (index >= bandCount) {
+		return 0;
+	}
+	// The top of the last band is not used
+	if (index + 1 < bandCount
+	 && ((index > 0 && upper <= bands[index - 1].upper)
+	  || (index + 2 < bandCount && upper >= bands[index + 1].upper))) {
+		return 0;
+	}
+
+	bands[index].upper = upper;
+	bands[index].hysteresis = hysteresis;
+	bands[index].duty = duty;
+	return 1;
+}
+
+uint8_t fan_band_current(void) {
+	return current;
+}
+
+uint16_t fan_band_transitions(void) {
+	return transitions;
+}
+
+uint16_t fan_band_transitions_per_hour(void) {
+	return lastHourTransitions;
+}
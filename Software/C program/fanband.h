@@ -0,0 +1,48 @@
+#ifndef FANBAND_H
+#define FANBAND_H
+/*
+ * Discrete fan speed bands with hysteresis and a minimum dwell time.
+ *
+ * The band only goes up once the reading passes the top of the current
+ * band, and only comes down once it falls 'hysteresis' tenths below the
+ * top of the band underneath. After a change the speed is held for at
+ * least the dwell time, so a reading hovering on an edge no longer
+ * toggles the fan (and the LCD) on every sample.
+ */
+
+#include <inttypes.h>
+
+#define FAN_BAND_MAX  8
+
+typedef struct {
+	int16_t upper;       // tenths of a degree C, top of the band (ignored for the last band)
+	uint8_t hysteresis;  // tenths of a degree below 'upper' needed to drop back into this band
+	uint8_t duty;        // OCR0/OCR2 value while in the band
+} fan_band_t;
+
+// Load the band table from flash. dwell_ms is the minimum time between changes.
+extern void fan_band_init(const fan_band_t *bands, uint8_t count, uint16_t dwell_ms);
+
+// Feed a reading, 'now' is scheduler_millis(). Returns the duty of the
+// current band.
+extern uint8_t fan_band_update(int16_t temp, uint16_t now);
+
+// Keep the dwell and hour timers going, 'now' is scheduler_millis(). The
+// 16-bit clock wraps after 65 s, so call this at least every 30 s even
+// while no readings are fed; fan_band_update() calls it too.
+extern void fan_band_clock(uint16_t now);
+
+// Change band 'index' of the table in use. Returns 0, changing nothing,
+// when the tops of the bands would no longer be increasing.
+extern uint8_t fan_band_set(uint8_t index, int16_t upper, uint8_t hysteresis, uint8_t duty);
+
+// Index of the current band, 0 is the coolest
+extern uint8_t fan_band_current(void);
+
+// Band changes since start
+extern uint16_t fan_band_transitions(void);
+
+// Band changes during the last complete hour
+extern uint16_t fan_band_transitions_per_hour(void);
+
+#endif // FANBAND_H
@@ -0,0 +1,29 @@
+#ifndef FMT_H
+#define FMT_H
+/*
+ * Fixed-width number formatting for the LCD, in place of sprintf().
+ *
+ * Every function writes exactly 'width' characters, right-aligned and
+ * padded with blanks, and never a terminating NUL. A value that does not
+ * fit is shown as '*' in every position instead of spilling over, so a
+ * field on the LCD can never push the rest of the line out of place.
+ * Each returns the position right after the field, so fields can be
+ * chained into one line buffer.
+ *
+ * No division, digits are found by subtracting powers of ten, which are
+ * kept in flash. The only AVR header is <avr/pgmspace.h>, which the host
+ * build replaces.
+ */
+
+#include <inttypes.h>
+
+// Decimal integer, e.g. "  -42"
+extern char *fmt_int(char *dst, uint8_t width, int16_t value);
+
+// Tenths as a decimal with one place, e.g. " 26.3" or "-0.5"
+extern char *fmt_fixed1(char *dst, uint8_t width, int16_t tenths);
+
+// Percentage including the sign, e.g. " 50%", the '%' counts towards width
+extern char *fmt_percent(char *dst, uint8_t width, uint8_t percent);
+
+#endif // FMT_H
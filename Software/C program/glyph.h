@@ -0,0 +1,48 @@
+#ifndef GLYPH_H
+#define GLYPH_H
+/*
+ * Custom characters in the HD44780's eight CGRAM slots, and bar graphs
+ * drawn with them.
+ *
+ * glyph_load() remembers which flash bitmap each slot holds and only
+ * uploads when that changes, so code can ask for its glyphs every time
+ * it draws. With LCD_ASYNC the upload goes through the LCD queue like
+ * everything else, and lcd_fb_flush() moves the address back to DDRAM.
+ * Without the framebuffer the screens are written directly, so the
+ * upload is too.
+ *
+ * The controller mirrors the slots at character codes 8..15. Those are
+ * used here so glyph 0 is not the string terminator. GLYPH_CHAR(2) is
+ * '\n', which lcd_fb_putc() takes as a line break, so slot 2 only suits
+ * glyphs sent some other way.
+ */
+
+#include <inttypes.h>
+
+#define GLYPH_SLOTS      8
+#define GLYPH_ROWS       8      // bytes per bitmap, 5 columns in bits 4..0
+#define GLYPH_CHAR(slot) ((char)(8 + (slot)))
+
+#define GLYPH_BAR_SLOT   4      // first of the four partial bar glyphs, slots 4..7
+#define GLYPH_BAR_STEPS  5      // columns per character cell
+
+#if GLYPH_BAR_SLOT + GLYPH_BAR_STEPS - 1 > GLYPH_SLOTS \
+ || (GLYPH_BAR_SLOT <= '\n' - 8 && '\n' - 8 < GLYPH_BAR_SLOT + GLYPH_BAR_STEPS - 1)
+#error "the bar glyphs must fit into CGRAM and keep clear of slot 2, GLYPH_CHAR(2) is '\n'"
+#endif
+
+// Forget what the slots hold, call after lcd_init()
+extern void glyph_init(void);
+
+// Make sure 'slot' holds the GLYPH_ROWS byte flash bitmap. Returns 0 when
+// the LCD queue is too full to take the upload, try again on the next draw.
+extern uint8_t glyph_load(uint8_t slot, const uint8_t *bitmap);
+
+// Draw a bar of 'cells' characters into the framebuffer at x, y, filled in
+// proportion to value / full with 5 steps per cell.
+extern void glyph_bar(uint8_t x, uint8_t y, uint8_t cells, uint16_t value, uint16_t full);
+
+// CGRAM uploads since glyph_init()
+extern uint16_t glyph_uploads(void);
+
+#endif // GLYPH_H
@@ -0,0 +1,40 @@
+#ifndef HAL_H
+#define HAL_H
+/*
+ * Hooks between the firmware and whatever runs it.
+ *
+ * The firmware keeps talking to PORTA, OCR0, ADMUX and friends directly,
+ * so every access still compiles to a single in/out/sbi/cbi on the
+ * ATmega64. Off-target, Simulation/host puts its own <avr/...> headers
+ * first on the include path: they turn the registers into plain memory
+ * and the hooks below into calls into the simulator, which is how the
+ * whole firmware builds and runs as a Linux program.
+ *
+ * On the AVR every hook is an empty inline function and costs nothing.
+ */
+
+#include <inttypes.h>
+
+#ifdef __AVR__
+
+// Called by the main loop after each pass over the tasks
+static inline void hal_idle(void) {}
+
+// Called while a strobe line (LCD enable) is held active
+static inline void hal_strobe(void) {}
+
+#else
+
+// Host build: advance simulated time to the next peripheral event and run
+// the interrupts that fall due
+extern void hal_idle(void);
+
+// Host build: let the simulated peripheral latch the bus
+extern void hal_strobe(void);
+
+// Host build: busy-wait loops and _delay_us() only move simulated time on
+extern void hal_delay_cycles(uint32_t cycles);
+
+#endif
+
+#endif // HAL_H
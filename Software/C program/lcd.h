@@ -19,7 +19,7 @@
  added 4-bit I/O mode, improved and optimized code.
        
  Library can be operated in memory mapped mode (LCD_IO_MODE=0) or in 
- 4-bit IO port mode (LCD_IO_MODE=1). 8-bit IO port mode not supported.
+ IO port mode (LCD_IO_MODE=1) with a 4-bit or an 8-bit data bus (LCD_IO_8BIT).
 
  Memory mapped mode compatible with Kanda STK200, but supports also 
  generation of R/W signal through A8 address line.
@@ -42,9 +42,9 @@
 
 /** 
  *  @name  Definitions for MCU Clock Frequency
- *  Adapt the MCU clock frequency in Hz to your target. 
+ *  The delay loops and the enable pulse follow F_CPU from clock.h.
  */
-#define XTAL 16000000              /**< clock frequency in Hz, used to calculate delay timer */
+#include "clock.h"
 
 
 /**
@@ -66,9 +66,71 @@
 #define LCD_START_LINE4  0x54     /**< DDRAM address of first char of line 4 */
 #define LCD_WRAP_LINES      0     /**< 0: no wrap, 1: wrap at end of visibile line */
 
+/**
+ *  @name  Definition for the shadow framebuffer
+ *  With LCD_FRAMEBUFFER=1 the lcd_fb_*() functions keep a copy of the screen in
+ *  RAM, and lcd_fb_flush() only sends the characters that changed.
+ */
+#define LCD_FRAMEBUFFER     1     /**< 0: direct writes only, 1: shadow framebuffer (2*LCD_LINES*LCD_DISP_LENGTH bytes RAM) */
+
+/**
+ *  @name  Definitions for asynchronous output
+ *  With LCD_ASYNC=1 the *_async() functions only queue their bytes, and
+ *  lcd_async_tick(), called from a timer interrupt every LCD_ASYNC_TICK_US,
+ *  writes one byte per call without polling the busy flag. lcd_fb_flush()
+ *  then queues as well. Do not call the blocking functions while the
+ *  queue is not idle.
+ */
+#define LCD_ASYNC            1     /**< 0: blocking writes only, 1: add the interrupt driven queue */
+#define LCD_ASYNC_QUEUE_SIZE 64    /**< queued bytes, power of two up to 128 */
+#define LCD_ASYNC_TICK_US    1000  /**< microseconds between lcd_async_tick() calls */
+
+#if LCD_ASYNC
+#if (LCD_ASYNC_QUEUE_SIZE & (LCD_ASYNC_QUEUE_SIZE - 1)) || LCD_ASYNC_QUEUE_SIZE > 128
+#error "LCD_ASYNC_QUEUE_SIZE must be a power of two up to 128"
+#endif
+#if LCD_ASYNC_TICK_US < 50
+#error "LCD_ASYNC_TICK_US must leave the controller at least 50us per instruction"
+#endif
+#endif
+
+
+/**
+ *  @name  Definitions for timed mode
+ *  With LCD_TIMED_MODE=1 the library never reads the controller. Every
+ *  instruction is followed by a fixed delay derived from F_CPU, so RW can be
+ *  tied to GND and LCD_RW_PIN is free for other use. lcd_getxy() is not
+ *  available and LCD_WRAP_LINES must be 0.
+ *  The delays cover the slowest HD44780 oscillator (190 kHz).
+ */
+#define LCD_TIMED_MODE      0     /**< 0: poll the busy flag through RW, 1: fixed delays, RW tied low */
+#define LCD_DELAY_EXEC_US   53    /**< execution time of a write or most instructions, us */
+#define LCD_DELAY_CLEAR_US  CLOCK_LCD_CLEAR_US  /**< execution time of clear display and return home, us */
+
+#if LCD_TIMED_MODE && LCD_WRAP_LINES
+#error "LCD_WRAP_LINES needs the address counter, which timed mode cannot read"
+#endif
+
 
 #define LCD_IO_MODE      1         /**< 0: memory mapped mode, 1: IO port mode */
-#if LCD_IO_MODE
+#define LCD_IO_8BIT      0         /**< IO port mode only, 0: 4-bit data bus, 1: 8-bit data bus */
+#if LCD_IO_MODE && LCD_IO_8BIT
+/**
+ *  @name Definitions for 8-bit IO mode
+ *  The eight data lines DB0..DB7 take a whole port, bit n to DBn, so a byte
+ *  goes out with one port write and one enable strobe. The control lines
+ *  move to PG0..PG2, which are free when the external memory interface is
+ *  not used.
+ */
+#define LCD_DATA_PORT    PORTD        /**< port for the 8 data lines */
+#define LCD_RS_PORT      PORTG        /**< port for RS line         */
+#define LCD_RS_PIN       0            /**< pin  for RS line         */
+#define LCD_RW_PORT      PORTG        /**< port for RW line         */
+#define LCD_RW_PIN       1            /**< pin  for RW line         */
+#define LCD_E_PORT       PORTG        /**< port for Enable line     */
+#define LCD_E_PIN        2            /**< pin  for Enable line     */
+
+#elif LCD_IO_MODE
 /**
  *  @name Definitions for 4-bit IO mode
  *  Change LCD_PORT if you want to use a different port for the LCD pins.
@@ -238,6 +300,20 @@ extern void lcd_puts(const char *s);
 extern void lcd_puts_p(const char *progmem_s);
 
 
+/**
+ @brief    Overwrite a whole line
+
+ Sets the DDRAM address once and writes the characters with fixed delays,
+ without a busy flag check per character. Short buffers are padded with
+ blanks, long ones are cut at LCD_DISP_LENGTH.
+ @param    row line to overwrite\n (0: first line)
+ @param    buf characters to display, need not be NUL terminated
+ @param    len number of characters in buf
+ @return   none
+*/
+extern void lcd_write_line(uint8_t row, const char *buf, uint8_t len);
+
+
 /**
  @brief    Send LCD controller instruction command
  @param    cmd instruction to send to LCD controller, see HD44780 data sheet
@@ -256,6 +332,175 @@ extern void lcd_command(uint8_t cmd);
 extern void lcd_data(uint8_t data);
 
 
+#if LCD_FRAMEBUFFER
+/**
+ @brief    Fill the framebuffer with blanks and move its cursor home
+
+ Nothing is sent to the display until lcd_fb_flush(). Do not mix the
+ framebuffer with direct writes (lcd_puts(), lcd_clrscr(), ...) without
+ calling lcd_fb_invalidate() afterwards.
+ @param    void
+ @return   none
+*/
+extern void lcd_fb_clear(void);
+
+
+/**
+ @brief    Set the framebuffer cursor
+ @param    x horizontal position\n (0: left most position)
+ @param    y vertical position\n   (0: first line)
+ @return   none
+*/
+extern void lcd_fb_gotoxy(uint8_t x, uint8_t y);
+
+
+/**
+ @brief    Write character into the framebuffer at the cursor
+
+ '\n' moves to the start of the next line. Characters past the end of a
+ line are dropped, like LCD_WRAP_LINES=0.
+ @param    c character to be displayed
+ @return   none
+*/
+extern void lcd_fb_putc(char c);
+
+
+/**
+ @brief    Write string into the framebuffer
+ @param    s string to be displayed
+ @return   none
+*/
+extern void lcd_fb_puts(const char *s);
+
+
+/**
+ @brief    Write a fixed number of characters into the framebuffer
+ @param    buf characters to display, need not be NUL terminated
+ @param    len number of characters in buf
+ @return   none
+*/
+extern void lcd_fb_write(const char *buf, uint8_t len);
+
+
+/**
+ @brief    Write string from program memory into the framebuffer
+ @param    progmem_s string from program memory be be displayed
+ @return   none
+*/
+extern void lcd_fb_puts_p(const char *progmem_s);
+
+
+/**
+ @brief    Send the cells that differ from what the display shows
+
+ Each run of changed cells costs one lcd_gotoxy() plus one lcd_data() per
+ character. An unchanged screen sends nothing.
+ @param    void
+ @return   bytes sent to the controller (commands and data)
+*/
+extern uint8_t lcd_fb_flush(void);
+
+
+/**
+ @brief    Forget what the display shows, the next flush redraws every cell
+ @param    void
+ @return   none
+*/
+extern void lcd_fb_invalidate(void);
+
+
+/**
+ @brief    Bytes sent by all flushes since lcd_init()
+ @param    void
+ @return   total count, wraps at 65535
+*/
+extern uint16_t lcd_fb_bytes_sent(void);
+#else
+/*
+ Without the framebuffer the lcd_fb_*() calls write straight to the display
+ and every draw sends the whole text again; there is nothing to flush.
+*/
+#define lcd_fb_clear()          lcd_clrscr()
+#define lcd_fb_gotoxy(x, y)     lcd_gotoxy(x, y)
+#define lcd_fb_putc(c)          lcd_putc(c)
+#define lcd_fb_puts(s)          lcd_puts(s)
+#define lcd_fb_puts_p(s)        lcd_puts_p(s)
+extern void lcd_fb_write(const char *buf, uint8_t len);
+static inline uint8_t lcd_fb_flush(void) { return 0; }
+static inline void lcd_fb_invalidate(void) { }
+static inline uint16_t lcd_fb_bytes_sent(void) { return 0; }
+#endif
+
+
+#if LCD_ASYNC
+/**
+ @brief    Queue instruction command, returns at once
+ @param    cmd instruction to send to LCD controller, see HD44780 data sheet
+ @return   0 if the queue is full
+*/
+extern uint8_t lcd_command_async(uint8_t cmd);
+
+
+/**
+ @brief    Queue data byte, returns at once
+ @param    data byte to send to LCD controller, see HD44780 data sheet
+ @return   0 if the queue is full
+*/
+extern uint8_t lcd_data_async(uint8_t data);
+
+
+/**
+ @brief    Queue cursor position, returns at once
+ @param    x horizontal position\n (0: left most position)
+ @param    y vertical position\n   (0: first line)
+ @return   0 if the queue is full
+*/
+extern uint8_t lcd_gotoxy_async(uint8_t x, uint8_t y);
+
+
+/**
+ @brief    Queue string without auto linefeed, returns at once
+
+ The string is queued completely or not at all.
+ @param    s string to be displayed
+ @return   0 if the string does not fit into the queue
+*/
+extern uint8_t lcd_puts_async(const char *s);
+
+
+/**
+ @brief    Free places in the queue
+ @param    void
+ @return   number of bytes that can be queued
+*/
+extern uint8_t lcd_async_free(void);
+
+
+/**
+ @brief    Check whether everything queued has been written
+ @param    void
+ @return   nonzero when idle, blocking calls are safe again
+*/
+extern uint8_t lcd_async_idle(void);
+
+
+/**
+ @brief    Drop all queued bytes, call from an interrupt or with interrupts disabled
+ @param    void
+ @return   none
+*/
+extern void lcd_async_cancel(void);
+
+
+/**
+ @brief    Write the next queued byte, call every LCD_ASYNC_TICK_US from a timer interrupt
+ @param    void
+ @return   none
+*/
+extern void lcd_async_tick(void);
+#endif
+
+
 /**
  @brief macros for automatically storing string constant in program memory
 */
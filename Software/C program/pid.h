@@ -0,0 +1,43 @@
+#ifndef PID_H
+#define PID_H
+/*
+ * Fixed-point PID controller for the fan.
+ *
+ * The fan cools, so the controller is reverse acting: the output rises
+ * when the measurement is above the setpoint. Temperatures are in tenths
+ * of a degree C, the output is an OCR0/OCR2 duty. Gains are Q8 values in
+ * duty per tenth of a degree and already include the sample period, so
+ * pid_update() must be called at a fixed rate.
+ *
+ * The derivative acts on the measurement only, so setpoint changes do
+ * not kick the output. The integral is clamped to the output range and
+ * frozen while the output is saturated in the direction it would grow
+ * (anti-windup).
+ *
+ * Plain C without AVR headers, so the host simulation can link it too.
+ */
+
+#include <inttypes.h>
+
+typedef struct {
+	int16_t kp;              // Q8 duty per tenth of a degree of error
+	int16_t ki;              // Q8 duty per tenth of a degree per sample
+	int16_t kd;              // Q8 duty per tenth of a degree change per sample
+	int16_t setpoint;        // tenths of a degree C
+	uint8_t outMin;
+	uint8_t outMax;
+	int32_t integral;        // Q8 duty
+	int16_t lastMeasurement;
+	uint8_t primed;          // lastMeasurement is valid
+} pid_ctrl_t;
+
+extern void pid_init(pid_ctrl_t *pid, int16_t kp, int16_t ki, int16_t kd,
+                     int16_t setpoint, uint8_t outMin, uint8_t outMax);
+
+// Forget the integral and derivative history, e.g. while the fan is off
+extern void pid_reset(pid_ctrl_t *pid);
+
+// Run one control step and return the new duty
+extern uint8_t pid_update(pid_ctrl_t *pid, int16_t measurement);
+
+#endif // PID_H
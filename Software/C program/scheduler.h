@@ -0,0 +1,53 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+/*
+ * Cooperative task scheduler driven by a 1 ms Timer1 CTC tick.
+ *
+ * Tasks are plain functions registered with a period and a deadline. The
+ * main loop calls scheduler_run() as often as it can, which starts every
+ * task whose period has elapsed. Tasks run to completion, so they must
+ * return quickly and never call _delay_ms().
+ *
+ * Drivers that need a fixed sampling rate can also hook into the tick
+ * interrupt itself.
+ */
+
+#include <inttypes.h>
+
+#include "clock.h"
+
+#define SCHED_TICK_HZ    1000   // tick frequency, one tick per millisecond
+#define SCHED_MAX_TASKS  10     // size of the static task table
+#define SCHED_MAX_HOOKS  4      // functions called from the tick interrupt
+
+_Static_assert(F_CPU / SCHED_TICK_HZ - 1 <= 0xFFFF, "Timer1 cannot make the tick without a prescaler");
+
+typedef void (*task_fn_t)(void);
+
+// Start the Timer1 tick. Call before sei().
+extern void scheduler_init(void);
+
+// Register a periodic task. The task is first released one period from now.
+// deadline_ms is the maximum lateness allowed before a miss is counted.
+// Returns the task id, or 0xFF when the table is full.
+extern uint8_t scheduler_add(task_fn_t fn, uint16_t period_ms, uint16_t deadline_ms);
+
+// Register a function that runs inside the tick interrupt every
+// millisecond, for sampling that must not depend on the main loop. Hooks
+// run with interrupts disabled and must take only a few microseconds.
+// Returns 0 when the hook table is full.
+extern uint8_t scheduler_add_tick_hook(task_fn_t fn);
+
+// Run every task that is due. Call from the main loop.
+extern void scheduler_run(void);
+
+// Milliseconds since scheduler_init(), wraps every 65.5 s.
+extern uint16_t scheduler_millis(void);
+
+// Number of times a task started later than its deadline.
+extern uint16_t scheduler_misses(uint8_t id);
+
+// True once 'time' (a scheduler_millis() value) has been reached.
+#define scheduler_expired(time) ((int16_t)(scheduler_millis() - (time)) >= 0)
+
+#endif // SCHEDULER_H
@@ -0,0 +1,79 @@
+#include <avr/pgmspace.h>
+
+#include "uart.h"
+#include "telemetry.h"
+
+// Largest frame: seq, type, payload and CRC, one COBS code byte in front
+// (no run is 254 bytes long) and the delimiter
+#define FRAME_MAX  (TELEMETRY_MAX_PAYLOAD + 3 + 1 + 1)
+
+_Static_assert(FRAME_MAX < UART_TX_SIZE, "a telemetry frame never fits into the UART ring");
+
+// CRC-8 of a high nibble, the polynomial 0x07 applied four bits at a time
+static const uint8_t crcNibble[16] PROGMEM = {
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+	0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+// COBS encoder writing into a frame: every zero becomes the distance to
+// the next one, stored where the zero would have been
+typedef struct {
+	uint8_t *frame;
+	uint8_t len;          // bytes in the frame so far
+	uint8_t code;         // index of the pending code byte
+	uint8_t crc;
+} encoder_t;
+
+static uint8_t seq = 0;
+static uint16_t drops = 0;
+
+
+static uint8_t crc8(uint8_t crc, uint8_t data) {
+	crc ^= data;
+	crc = (crc << 4) ^ pgm_read_byte(&crcNibble[crc >> 4]);
+	crc = (crc << 4) ^ pgm_read_byte(&crcNibble[crc >> 4]);
+	return crc;
+}
+
+static void put(encoder_t *e, uint8_t data) {
+	if (data == 0) {
+		e->frame[e->code] = e->len - e->code;
+		e->code = e->len++;
+	} else {
+		e->frame[e->len++] = data;
+	}
+}
+
+static void put_crc(encoder_t *e, uint8_t data) {
+	e->crc = crc8(e->crc, data);
+	put(e, data);
+}
+
+uint8_t telemetry_send(uint8_t type, const void *payload, uint8_t len) {
+	uint8_t frame[FRAME_MAX];
+	const uint8_t *p = payload;
+	encoder_t e = { frame, 1, 0, 0 };
+
+	if (len > TELEMETRY_MAX_PAYLOAD) {
+		len = TELEMETRY_MAX_PAYLOAD;
+	}
+
+	put_crc(&e, seq++);
+	put_crc(&e, type);
+	while (len--) {
+		put_crc(&e, *p++);
+	}
+	put(&e, e.crc);
+	frame[e.code] = e.len - e.code; // last run ends at the delimiter
+	frame[e.len++] = 0;
+
+	if (!uart_write(frame, e.len)) {
+		drops++;
+		return 0;
+	}
+	return 1;
+}
+
+uint16_t telemetry_drops(void) {
+	return drops;
+}
@@ -0,0 +1,49 @@
+#ifndef UART_H
+#define UART_H
+/*
+ * Interrupt-driven USART0, TXD0 on PE1 and RXD0 on PE0.
+ *
+ * uart_write() copies a block into a ring and returns straight away; the
+ * data register empty interrupt hands the USART one byte at a time. A
+ * block that does not fit is refused whole and counted, never waited
+ * for, so output can fall behind but cannot stall a task or leave half
+ * a frame on the line.
+ *
+ * Received bytes go into a second ring from the receive complete
+ * interrupt, where uart_read() picks them up one at a time. Bytes that
+ * arrive while it is full, or with a framing error, are lost and counted.
+ */
+
+#include <inttypes.h>
+
+#include "clock.h"
+
+#define UART_TX_SIZE  128    // ring sizes in bytes, power of two, 8-bit indices
+#define UART_RX_SIZE  32
+
+#if (UART_TX_SIZE & (UART_TX_SIZE - 1)) || UART_TX_SIZE > 128
+#error "UART_TX_SIZE must be a power of two up to 128"
+#endif
+#if (UART_RX_SIZE & (UART_RX_SIZE - 1)) || UART_RX_SIZE > 128
+#error "UART_RX_SIZE must be a power of two up to 128"
+#endif
+
+// CLOCK_UART_BAUD, 8 data bits, no parity, 1 stop bit
+extern void uart_init(void);
+
+// Queue 'len' bytes. Returns 0, and counts a drop, when they do not all fit.
+extern uint8_t uart_write(const uint8_t *buf, uint8_t len);
+
+// Bytes that can be queued right now
+extern uint8_t uart_tx_free(void);
+
+// Blocks refused because the ring was full
+extern uint16_t uart_tx_drops(void);
+
+// Take the oldest received byte. Returns 0 when there is none.
+extern uint8_t uart_read(uint8_t *byte);
+
+// Received bytes lost to a full ring, an overrun or a framing error
+extern uint16_t uart_rx_errors(void);
+
+#endif // UART_H